@@ -16,82 +16,62 @@
 // limitations under the License.
 
 #include <arrow.hpp>
+#include <mutex>
 
 namespace bamboo {
 namespace arrow {
 
-unique_ptr<Node> convert(const Array& array);
-
-void update_nulls(const Array& array, Node& node) {
-    // it would be better to directly copy the null array values (or do it in a way that is more
-    // conducive to optimization)
-    for (size_t i = 0; i < array.length(); i++) {
-        if (array.IsNull(i)) {
-            node.add_null();
-        } else {
-            node.add_not_null();
-        }
+class EnumMemo;
+
+unique_ptr<Node> convert(const Array& array, const ColumnFilter* column_filter,
+                         bool implicit_include, EnumMemo& enum_memo);
+
+// whether any values of the given type pass the filter (with the same semantics as the Avro and
+// protobuf filters)
+static bool any_included(const DataType& type, const ColumnFilter* column_filter,
+                         bool implicit_include) {
+    if (!column_filter) {
+        return implicit_include;
+    }
+    bool included = ColumnFilter::included(column_filter, implicit_include);
+    switch (type.id()) {
+        case Type::STRUCT:
+            for (const auto& child : type.children()) {
+                if (any_included(*child->type(), ColumnFilter::child(column_filter, child->name()),
+                                 included)) {
+                    return true;
+                }
+            }
+            return false;
+        case Type::LIST:
+            return any_included(*type.child(0)->type(), column_filter, implicit_include);
+        default:
+            return included;
     }
 }
 
-template <class T> void add_primitives(const NumericArray<T>& array, PrimitiveNode& node) {
-    for (size_t i = 0; i < array.length(); i++) {
-        node.add(array.Value(i));
-    }
+static TemporalUnit temporal_unit(TimeUnit::type unit) {
+    switch (unit) {
+        case TimeUnit::SECOND:
+            return TemporalUnit::SECOND;
+        case TimeUnit::MILLI:
+            return TemporalUnit::MILLI;
+        case TimeUnit::MICRO:
+            return TemporalUnit::MICRO;
+        case TimeUnit::NANO:
+            return TemporalUnit::NANO;
+    }
+    throw std::invalid_argument("Unknown time unit");
 }
 
-// we should share pieces of this (indexing) with the node visitor, but the templating is a bit
-// tricky
-class IndexArrayVisitor : public virtual ArrayVisitor {
-   private:
-    vector<size_t> indices;
-    PrimitiveNode& enum_node;
-
-   public:
-    IndexArrayVisitor(PrimitiveNode& enum_node) : enum_node(enum_node) {}
-
-    vector<size_t> take_result() {
-        return std::move(indices);
-    }
-
-    template <class T> Status handle_numeric(const NumericArray<T>& array) {
-        for (size_t i = 0; i < array.length(); i++) {
-            if (!array.IsNull(i)) {
-                indices.push_back(array.Value(i));
-            }
-        }
-        return Status::OK();
-    }
-
-    virtual Status Visit(const Int8Array& array) final override {
-        return handle_numeric(array);
-    }
-    virtual Status Visit(const Int16Array& array) final override {
-        return handle_numeric(array);
-    }
-    virtual Status Visit(const Int32Array& array) final override {
-        return handle_numeric(array);
-    }
-    virtual Status Visit(const Int64Array& array) final override {
-        return handle_numeric(array);
-    }
-    virtual Status Visit(const UInt8Array& array) final override {
-        return handle_numeric(array);
-    }
-    virtual Status Visit(const UInt16Array& array) final override {
-        return handle_numeric(array);
-    }
-    virtual Status Visit(const UInt32Array& array) final override {
-        return handle_numeric(array);
-    }
-    virtual Status Visit(const UInt64Array& array) final override {
-        return handle_numeric(array);
-    }
-};
+void update_nulls(const Array& array, Node& node) {
+    node.append_validity(array.null_bitmap_data(), array.offset(), array.length(),
+                         array.null_count());
+}
 
 struct ArrowDynamicEnum : public DynamicEnum {
-    ArrowDynamicEnum(unique_ptr<PrimitiveNode> enum_values_node)
-        : enum_values_node(std::move(enum_values_node)){};
+    ArrowDynamicEnum(unique_ptr<PrimitiveNode> enum_values_node, shared_ptr<Array> dictionary)
+        : enum_values_node(std::move(enum_values_node)), dictionary(dictionary){};
 
     virtual ~ArrowDynamicEnum() final override = default;
 
@@ -99,51 +79,129 @@ struct ArrowDynamicEnum : public DynamicEnum {
         return *enum_values_node->get_vector();
     }
 
-    // assume that every arrow enum is consistently sourced
+    // the batches of a stream share their dictionary (unless it is replaced), so the dictionary
+    // identifies the enum across batches
     virtual const void* source() final override {
-        return 0;
+        return dictionary.get();
+    }
+
+    // a delta dictionary extends the dictionary of the previous batches
+    virtual bool extends(DynamicEnum& other) final override {
+        ArrowDynamicEnum* other_enum = dynamic_cast<ArrowDynamicEnum*>(&other);
+        if (!other_enum) {
+            return false;
+        }
+        const Array& other_dictionary = *other_enum->dictionary;
+        return dictionary == other_enum->dictionary ||
+               (other_dictionary.length() <= dictionary->length() &&
+                dictionary->RangeEquals(other_dictionary, 0, other_dictionary.length(), 0));
     }
 
    private:
     unique_ptr<PrimitiveNode> enum_values_node;
+    // held so that the source stays unique
+    shared_ptr<Array> dictionary;
+};
+
+// the enums of the dictionaries converted so far, so that the batches sharing a dictionary also
+// share its enum (rather than converting the dictionary for every batch)
+class EnumMemo {
+    std::mutex mutex;
+    map<const Array*, shared_ptr<ArrowDynamicEnum>> enums;
+
+   public:
+    shared_ptr<ArrowDynamicEnum> get(const std::shared_ptr<Array>& dictionary);
 };
 
 class NodeArrayVisitor : public virtual ArrayVisitor {
    private:
     unique_ptr<Node> node;
+    const ColumnFilter* column_filter;
+    bool implicit_include;
+    EnumMemo& enum_memo;
 
    public:
+    NodeArrayVisitor(const ColumnFilter* column_filter, bool implicit_include, EnumMemo& enum_memo)
+        : column_filter(column_filter), implicit_include(implicit_include), enum_memo(enum_memo) {}
+
     unique_ptr<Node> take_result() {
         return std::move(node);
     }
 
-    template <class A, class P>
-    Status handle_generic(A array, std::function<P(A, size_t i)> const& extractor) {
+    template <PrimitiveType P> typename VectorTyper<P>::vector_type& init_values() {
         node = make_unique<PrimitiveNode>();
         PrimitiveNode& pn = static_cast<PrimitiveNode&>(*node);
-        for (size_t i = 0; i < array.length(); i++) {
-            if (!array.IsNull(i)) {
-                pn.add(extractor(array, i));
+        pn.init_type<P>();
+        return pn.get_vector()->get_typed_vector<P>();
+    }
+
+    // the values of an array without nulls are used in place (the node keeps the array data
+    // alive); otherwise the non-null values are compacted into the node
+    template <class V, class T> void fill_values(V& values, const NumericArray<T>& array) {
+        const typename T::c_type* raw = array.raw_values();
+        if (array.null_count() == 0) {
+            values.borrow(raw, array.length(), array.data());
+        } else {
+            auto* out = values.extend(array.length() - array.null_count());
+            for (int64_t i = 0; i < array.length(); i++) {
+                if (array.IsValid(i)) {
+                    *out++ = raw[i];
+                }
             }
         }
+    }
+
+    template <PrimitiveType P, class T> Status handle_values(const NumericArray<T>& array) {
+        fill_values(init_values<P>(), array);
         return Status::OK();
     }
 
-    // could we share more of this code with the generic version?
-    Status handle_float16(const HalfFloatArray& array) {
-        node = make_unique<PrimitiveNode>();
-        PrimitiveNode& pn = static_cast<PrimitiveNode&>(*node);
-        for (size_t i = 0; i < array.length(); i++) {
-            if (!array.IsNull(i)) {
-                pn.add_by_type<PrimitiveType::FLOAT16>(array.Value(i));
+    // temporal values keep their width and unit (so they can be viewed without conversion)
+    template <PrimitiveType P, class T>
+    Status handle_temporal(const NumericArray<T>& array, TemporalUnit unit,
+                           const string& timezone = "") {
+        auto& values = init_values<P>();
+        values.set_unit(unit, timezone);
+        fill_values(values, array);
+        return Status::OK();
+    }
+
+    template <PrimitiveType P> Status handle_binary(const BinaryArray& array) {
+        BinaryVector& values = init_values<P>();
+        // our offsets are wider than arrow's, so only the value data can be copied in bulk
+        const char* data = reinterpret_cast<const char*>(array.value_data()->data());
+        if (array.null_count() == 0) {
+            values.append(array.raw_value_offsets(), array.length(), data);
+            return Status::OK();
+        }
+        values.reserve(array.length() - array.null_count());
+        values.reserve_bytes(array.value_offset(array.length()) - array.value_offset(0));
+        for (int64_t i = 0; i < array.length(); i++) {
+            if (array.IsValid(i)) {
+                int32_t length;
+                const uint8_t* value = array.GetValue(i, &length);
+                values.add(reinterpret_cast<const char*>(value), length);
+            }
+        }
+        return Status::OK();
+    }
+
+    Status handle_fixed(const FixedSizeBinaryArray& array, FixedBinaryVector& values) {
+        if (array.null_count() == 0) {
+            values.append(array.raw_values(), array.length());
+            return Status::OK();
+        }
+        values.reserve(array.length() - array.null_count());
+        for (int64_t i = 0; i < array.length(); i++) {
+            if (array.IsValid(i)) {
+                values.add(array.GetValue(i));
             }
         }
         return Status::OK();
     }
 
     template <class T> Status handle_numeric(const NumericArray<T>& array) {
-        return handle_generic<const NumericArray<T>&, typename T::c_type>(
-            array, [](const NumericArray<T>& a, size_t i) { return a.Value(i); });
+        return handle_values<PrimitiveEnum<typename T::c_type>::primitive_enum>(array);
     }
 
     virtual Status Visit(const NullArray& array) final override {
@@ -152,8 +210,15 @@ class NodeArrayVisitor : public virtual ArrayVisitor {
     };
 
     virtual Status Visit(const BooleanArray& array) final override {
-        return handle_generic<const BooleanArray&, bool>(
-            array, [](const BooleanArray& a, size_t i) { return a.Value(i); });
+        // arrow packs booleans into bits, so these always need to be unpacked
+        uint8_t* out = init_values<PrimitiveType::BOOL>().extend(array.length() -
+                                                                 array.null_count());
+        for (int64_t i = 0; i < array.length(); i++) {
+            if (array.IsValid(i)) {
+                *out++ = array.Value(i);
+            }
+        }
+        return Status::OK();
     }
     virtual Status Visit(const Int8Array& array) final override {
         return handle_numeric(array);
@@ -180,7 +245,7 @@ class NodeArrayVisitor : public virtual ArrayVisitor {
         return handle_numeric(array);
     }
     virtual Status Visit(const HalfFloatArray& array) final override {
-        return handle_float16(array);
+        return handle_values<PrimitiveType::FLOAT16>(array);
     }
     virtual Status Visit(const FloatArray& array) final override {
         return handle_numeric(array);
@@ -189,41 +254,49 @@ class NodeArrayVisitor : public virtual ArrayVisitor {
         return handle_numeric(array);
     }
     virtual Status Visit(const StringArray& array) final override {
-        node = make_unique<PrimitiveNode>();
-        PrimitiveNode& pn = static_cast<PrimitiveNode&>(*node);
-        for (size_t i = 0; i < array.length(); i++) {
-            pn.add(array.GetString(i));
-        }
-        return Status::OK();
+        return handle_binary<PrimitiveType::STRING>(array);
     }
     virtual Status Visit(const BinaryArray& array) final override {
-        return Status::NotImplemented("BinaryArray not implemented");
+        return handle_binary<PrimitiveType::BYTE_ARRAY>(array);
     }
     virtual Status Visit(const FixedSizeBinaryArray& array) final override {
-        return Status::NotImplemented("FixedSizeBinaryArray not implemented");
+        node = make_unique<PrimitiveNode>();
+        PrimitiveNode& pn = static_cast<PrimitiveNode&>(*node);
+        pn.init_fixed(array.byte_width());
+        return handle_fixed(array,
+                            pn.get_vector()->get_typed_vector<PrimitiveType::FIXED_BYTE_ARRAY>());
     }
     virtual Status Visit(const Date32Array& array) final override {
-        return Status::NotImplemented("Date32Array not implemented");
+        return handle_temporal<PrimitiveType::DATE32>(array, TemporalUnit::DAY);
     }
     virtual Status Visit(const Date64Array& array) final override {
-        return Status::NotImplemented("Date64Array not implemented");
+        // date64 counts milliseconds, so it is the same as a (time zone naive) timestamp
+        return handle_temporal<PrimitiveType::TIMESTAMP>(array, TemporalUnit::MILLI);
     }
     virtual Status Visit(const Time32Array& array) final override {
-        return Status::NotImplemented("Time32Array not implemented");
+        const Time32Type& type = static_cast<const Time32Type&>(*array.type());
+        return handle_temporal<PrimitiveType::TIME32>(array, temporal_unit(type.unit()));
     }
     virtual Status Visit(const Time64Array& array) final override {
-        return Status::NotImplemented("Time64Array not implemented");
+        const Time64Type& type = static_cast<const Time64Type&>(*array.type());
+        return handle_temporal<PrimitiveType::TIME64>(array, temporal_unit(type.unit()));
     }
     virtual Status Visit(const TimestampArray& array) final override {
-        return Status::NotImplemented("TimestampArray not implemented");
+        const TimestampType& type = static_cast<const TimestampType&>(*array.type());
+        return handle_temporal<PrimitiveType::TIMESTAMP>(array, temporal_unit(type.unit()),
+                                                         type.timezone());
     }
     virtual Status Visit(const Decimal128Array& array) final override {
-        return Status::NotImplemented("Decimal128Array not implemented");
+        const Decimal128Type& type = static_cast<const Decimal128Type&>(*array.type());
+        DecimalVector& values = init_values<PrimitiveType::DECIMAL128>();
+        values.set_scale(type.precision(), type.scale());
+        return handle_fixed(array, values);
     }
     virtual Status Visit(const ListArray& array) final override {
         node = make_unique<ListNode>();
         // is there a cleaner way to do this without a raw pointer or cast?
         ListNode& ln = static_cast<ListNode&>(*node);
+        ln.reserve(array.length() - array.null_count());
         for (size_t i = 0; i < array.length(); i++) {
             if (!array.IsNull(i)) {
                 size_t length = array.value_offset(i + 1) - array.value_offset(i);
@@ -231,7 +304,7 @@ class NodeArrayVisitor : public virtual ArrayVisitor {
             }
         }
         unique_ptr<Node>& sub_node = ln.get_list();
-        sub_node = convert(*array.values());
+        sub_node = convert(*array.values(), column_filter, implicit_include, enum_memo);
         return Status::OK();
     }
 
@@ -239,9 +312,14 @@ class NodeArrayVisitor : public virtual ArrayVisitor {
         node = make_unique<RecordNode>();
         // is there a cleaner way to do this without a raw pointer or cast?
         RecordNode& rn = static_cast<RecordNode&>(*node);
+        bool included = !column_filter || ColumnFilter::included(column_filter, implicit_include);
         for (auto child : array.struct_type()->children()) {
-            unique_ptr<Node>& field_node = rn.get_field(child->name());
-            field_node = convert(*array.GetFieldByName(child->name()));
+            const ColumnFilter* child_filter = ColumnFilter::child(column_filter, child->name());
+            if (any_included(*child->type(), child_filter, included)) {
+                unique_ptr<Node>& field_node = rn.get_field(child->name());
+                field_node = convert(*array.GetFieldByName(child->name()), child_filter, included,
+                                     enum_memo);
+            }
         }
         return Status::OK();
     }
@@ -251,31 +329,47 @@ class NodeArrayVisitor : public virtual ArrayVisitor {
     }
 
     virtual Status Visit(const DictionaryArray& array) final override {
-        node = make_unique<PrimitiveNode>();
-        // is there a cleaner way to do this without a raw pointer or cast?
-        PrimitiveNode& pn = static_cast<PrimitiveNode&>(*node);
-        NodeArrayVisitor enum_visitor;
-        Status status = array.dictionary()->Accept(&enum_visitor);
-        // can an enum have a non-primitive type?
-        // this is a bit ugly -- do we have a better way?
-        std::unique_ptr<PrimitiveNode> enum_values_node = std::unique_ptr<PrimitiveNode>(
-            dynamic_cast<PrimitiveNode*>(enum_visitor.take_result().release()));
-        shared_ptr<ArrowDynamicEnum> enum_value =
-            std::make_shared<ArrowDynamicEnum>(std::move(enum_values_node));
-        IndexArrayVisitor index_visitor(pn);
-        Status index_status = array.indices()->Accept(&index_visitor);
-        // would be better if we could move this
+        // the indices keep their width (and are used in place if they have no nulls)
+        NodeArrayVisitor index_visitor(nullptr, true, enum_memo);
+        Status status = array.indices()->Accept(&index_visitor);
+        if (!status.ok()) {
+            return status;
+        }
+        unique_ptr<Node> index_node = index_visitor.take_result();
         DynamicEnumVector enum_vector;
-        enum_vector.index = index_visitor.take_result();
-        enum_vector.values = enum_value;
-        pn.get_vector() = make_unique<PrimitiveEnumVector>(std::move(enum_vector));
+        enum_vector.index = std::move(static_cast<PrimitiveNode&>(*index_node).get_vector());
+        enum_vector.values = enum_memo.get(array.dictionary());
 
+        node = make_unique<PrimitiveNode>();
+        static_cast<PrimitiveNode&>(*node).get_vector() =
+            make_unique<PrimitiveEnumVector>(std::move(enum_vector));
         return Status::OK();
     }
 };
 
-unique_ptr<Node> convert(const Array& array) {
-    NodeArrayVisitor node_visitor;
+shared_ptr<ArrowDynamicEnum> EnumMemo::get(const std::shared_ptr<Array>& dictionary) {
+    std::lock_guard<std::mutex> lock(mutex);
+    shared_ptr<ArrowDynamicEnum>& enum_values = enums[dictionary.get()];
+    if (!enum_values) {
+        // can an enum have a non-primitive type?
+        NodeArrayVisitor enum_visitor(nullptr, true, *this);
+        Status status = dictionary->Accept(&enum_visitor);
+        if (!status.ok()) {
+            throw std::runtime_error(status.message());
+        }
+        unique_ptr<PrimitiveNode> enum_values_node = unique_ptr<PrimitiveNode>(
+            dynamic_cast<PrimitiveNode*>(enum_visitor.take_result().release()));
+        if (!enum_values_node) {
+            throw std::runtime_error("Dictionary values must be primitive");
+        }
+        enum_values = std::make_shared<ArrowDynamicEnum>(std::move(enum_values_node), dictionary);
+    }
+    return enum_values;
+}
+
+unique_ptr<Node> convert(const Array& array, const ColumnFilter* column_filter,
+                         bool implicit_include, EnumMemo& enum_memo) {
+    NodeArrayVisitor node_visitor(column_filter, implicit_include, enum_memo);
     Status status = array.Accept(&node_visitor);
     if (status.ok()) {
         unique_ptr<Node> node = node_visitor.take_result();
@@ -286,14 +380,56 @@ unique_ptr<Node> convert(const Array& array) {
     }
 }
 
-unique_ptr<Node> convert(std::istream& is, const ColumnFilter* column_filter) {
-    std::shared_ptr<RecordBatchReader> output;
-    std::shared_ptr<ArrowInputStream> ais = std::make_shared<ArrowInputStream>(is);
-    std::shared_ptr<InputStream> ais_base = std::static_pointer_cast<InputStream>(ais);
-    Status status = ipc::RecordBatchStreamReader::Open(ais_base, &output);
+// the indices of the top level fields with values that pass the filter
+static vector<int> included_fields(const Schema& schema, const ColumnFilter* column_filter,
+                                   bool implicit_include) {
+    vector<int> included;
+    const vector<std::shared_ptr<Field>>& fields = schema.fields();
+    for (size_t i = 0; i < fields.size(); i++) {
+        if (any_included(*fields[i]->type(), ColumnFilter::child(column_filter, fields[i]->name()),
+                         implicit_include)) {
+            included.push_back(i);
+        }
+    }
+    return included;
+}
+
+// each batch is converted on its own and then appended to the columns of the previous batches
+// (borrowed values are appended as further runs, rather than copied)
+static void convert_batch(const RecordBatch& batch, const ColumnFilter* column_filter,
+                          bool implicit_include, EnumMemo& enum_memo, RecordNode& rn) {
+    for (size_t i = 0; i < batch.num_columns(); i++) {
+        std::shared_ptr<Array> column = batch.column(i);
+        const ColumnFilter* column_field_filter =
+            ColumnFilter::child(column_filter, batch.column_name(i));
+        if (any_included(*column->type(), column_field_filter, implicit_include)) {
+            unique_ptr<Node>& column_node = rn.get_field(batch.column_name(i));
+            column_node = convert(*column, column_field_filter, implicit_include, enum_memo);
+        }
+    }
+    rn.append_validity(nullptr, 0, batch.num_rows(), 0);
+}
+
+// reads the batches of the stream (positioned at its start), loading only the top level fields that
+// pass the filter
+static unique_ptr<Node> convert_stream(std::shared_ptr<InputStream> input, const Schema& schema,
+                                       const ColumnFilter* column_filter, size_t expected_rows) {
+    bool implicit_include = !column_filter || !column_filter->has_includes();
+    ipc::IpcReadOptions options = ipc::IpcReadOptions::Defaults();
+    options.included_fields = included_fields(schema, column_filter, implicit_include);
+    if (options.included_fields.empty()) {
+        // (an empty list would load every field)
+        return make_unique<IncompleteNode>();
+    }
+
+    Result<std::shared_ptr<RecordBatchReader>> reader =
+        ipc::RecordBatchStreamReader::Open(input, options);
+    if (!reader.ok()) {
+        throw std::runtime_error(reader.status().message());
+    }
+    std::shared_ptr<RecordBatchReader> output = *reader;
     std::shared_ptr<RecordBatch> batch;
-    // need to merge the nodes after these record batches
-    // or should the merge be done on the python side?
+    EnumMemo enum_memo;
     unique_ptr<ListNode> ln = make_unique<ListNode>();
     ln->get_list() = make_unique<RecordNode>();
     int64_t list_counter = 0;
@@ -305,14 +441,13 @@ unique_ptr<Node> convert(std::istream& is, const ColumnFilter* column_filter) {
         }
 
         if (batch) {
-            RecordNode& rn = static_cast<RecordNode&>(*ln->get_list().get());
-            for (size_t i = 0; i < batch->num_columns(); i++) {
-                std::shared_ptr<Array> column = batch->column(i);
-                unique_ptr<Node>& column_node = rn.get_field(batch->column_name(i));
-                column_node = convert(*column);
-            }
-            for (size_t i = 0; i < batch->num_rows(); i++) {
-                rn.add_not_null();
+            RecordNode rn;
+            convert_batch(*batch, column_filter, implicit_include, enum_memo, rn);
+            concat(ln->get_list(), rn);
+            // (the first batch's columns are moved into the list, so room for the rest is only
+            // reserved once they are)
+            if (list_counter == 0 && expected_rows > static_cast<size_t>(batch->num_rows())) {
+                ln->get_list()->reserve(expected_rows - batch->num_rows());
             }
             list_counter += batch->num_rows();
         } else {
@@ -325,5 +460,107 @@ unique_ptr<Node> convert(std::istream& is, const ColumnFilter* column_filter) {
     return std::move(ln);
 }
 
+unique_ptr<Node> convert(std::istream& is, const ColumnFilter* column_filter, size_t expected_rows) {
+    std::shared_ptr<ArrowInputStream> ais = std::make_shared<ArrowInputStream>(is);
+
+    // the schema is read up front (and then replayed to the batch reader) so that the reader can
+    // be told which top level fields to load; the message bodies of the others are not decoded
+    ais->record();
+    ipc::DictionaryMemo schema_memo;
+    Result<std::shared_ptr<Schema>> schema = ipc::ReadSchema(ais.get(), &schema_memo);
+    if (!schema.ok()) {
+        throw std::runtime_error(schema.status().message());
+    }
+    ais->replay();
+
+    return convert_stream(std::static_pointer_cast<InputStream>(ais), **schema, column_filter,
+                          expected_rows);
+}
+
+unique_ptr<Node> convert(std::shared_ptr<Buffer> buffer, const ColumnFilter* column_filter,
+                         size_t expected_rows) {
+    // the schema is read by a separate reader, as the buffer can simply be read again from the
+    // start
+    BufferReader schema_reader(buffer);
+    ipc::DictionaryMemo schema_memo;
+    Result<std::shared_ptr<Schema>> schema = ipc::ReadSchema(&schema_reader, &schema_memo);
+    if (!schema.ok()) {
+        throw std::runtime_error(schema.status().message());
+    }
+
+    // reading from a buffer gives message bodies that are slices of it, so the batches (and the
+    // values borrowed from them) refer to the buffer's memory
+    return convert_stream(std::make_shared<BufferReader>(buffer), **schema, column_filter,
+                          expected_rows);
+}
+
+template <class T> static T checked(Result<T>&& result) {
+    if (!result.ok()) {
+        throw std::runtime_error(result.status().message());
+    }
+    return std::move(result).ValueOrDie();
+}
+
+unique_ptr<Node> convert_file(const string& path, const ColumnFilter* column_filter,
+                              int64_t begin_batch, int64_t end_batch, size_t threads) {
+    bool implicit_include = !column_filter || !column_filter->has_includes();
+    // only the footer and the buffers of the requested batches (and of their included columns) are
+    // read from the file, into memory owned by the batches (where they have no nulls, their values
+    // are used in place by the nodes); they are read rather than mapped, as a mapping would change
+    // under the nodes if the file were later truncated or rewritten
+    std::shared_ptr<ReadableFile> file = checked(ReadableFile::Open(path));
+
+    // the footer holds the schema, so opening the file only to read it is cheap
+    std::shared_ptr<Schema> schema = checked(ipc::RecordBatchFileReader::Open(file))->schema();
+    ipc::IpcReadOptions options = ipc::IpcReadOptions::Defaults();
+    options.included_fields = included_fields(*schema, column_filter, implicit_include);
+    if (options.included_fields.empty()) {
+        return make_unique<IncompleteNode>();
+    }
+    std::shared_ptr<ipc::RecordBatchFileReader> reader =
+        checked(ipc::RecordBatchFileReader::Open(file, options));
+
+    int64_t batch_count = reader->num_record_batches();
+    if (end_batch < 0 || end_batch > batch_count) {
+        end_batch = batch_count;
+    }
+    begin_batch = std::min(std::max<int64_t>(begin_batch, 0), end_batch);
+    size_t count = end_batch - begin_batch;
+
+    threads = std::max<size_t>(1, std::min(thread_count(threads), count));
+
+    // the reader (which also holds the dictionaries, which all batches share) is used under a lock
+    // and only the conversion runs in parallel
+    std::mutex reader_mutex;
+    EnumMemo enum_memo;
+    vector<unique_ptr<RecordNode>> batch_nodes(count);
+    vector<int64_t> batch_rows(count);
+    parallel_for(threads, [&](size_t thread) {
+        for (size_t i = thread; i < count; i += threads) {
+            std::shared_ptr<RecordBatch> batch;
+            {
+                std::lock_guard<std::mutex> lock(reader_mutex);
+                batch = checked(reader->ReadRecordBatch(begin_batch + i));
+            }
+            batch_nodes[i] = make_unique<RecordNode>();
+            convert_batch(*batch, column_filter, implicit_include, enum_memo, *batch_nodes[i]);
+            batch_rows[i] = batch->num_rows();
+        }
+    });
+
+    unique_ptr<ListNode> ln = make_unique<ListNode>();
+    ln->get_list() = make_unique<RecordNode>();
+    int64_t list_counter = 0;
+    for (size_t i = 0; i < count; i++) {
+        concat(ln->get_list(), *batch_nodes[i]);
+        batch_nodes[i].reset();
+        list_counter += batch_rows[i];
+    }
+    ln->add_list(list_counter);
+    ln->add_not_null();
+
+    return std::move(ln);
+}
+
 }  // namespace arrow
 }  // namespace bamboo
@@ -0,0 +1,168 @@
+// Copyright (c) 2019 Michael Vilim
+//
+// This file is part of the bamboo library. It is currently hosted at
+// https://github.com/mvilim/bamboo
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <zlib.h>
+#include <algorithm>
+#include <avro_container.hpp>
+#include <cstring>
+#include <stdexcept>
+
+namespace bamboo {
+namespace avro {
+
+static const uint8_t magic[] = {'O', 'b', 'j', 1};
+static constexpr size_t sync_size = 16;
+
+class ByteReader {
+    const uint8_t* pos;
+    const uint8_t* end;
+
+   public:
+    ByteReader(const uint8_t* data, size_t size) : pos(data), end(data + size) {}
+
+    bool at_end() const {
+        return pos == end;
+    }
+
+    const uint8_t* read(size_t n) {
+        if (static_cast<size_t>(end - pos) < n) {
+            throw std::runtime_error("Unexpected end of Avro container");
+        }
+        const uint8_t* start = pos;
+        pos += n;
+        return start;
+    }
+
+    // a zig-zag encoded variable length long
+    int64_t read_long() {
+        uint64_t value = 0;
+        for (size_t shift = 0; shift < 64; shift += 7) {
+            uint8_t byte = *read(1);
+            value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+            if (!(byte & 0x80)) {
+                return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+            }
+        }
+        throw std::runtime_error("Invalid long in Avro container");
+    }
+
+    string read_string() {
+        int64_t length = read_long();
+        if (length < 0) {
+            throw std::runtime_error("Invalid length in Avro container");
+        }
+        const char* data = reinterpret_cast<const char*>(read(length));
+        return string(data, length);
+    }
+};
+
+Container::Container(const uint8_t* data, size_t size) {
+    ByteReader reader(data, size);
+    if (std::memcmp(reader.read(sizeof(magic)), magic, sizeof(magic)) != 0) {
+        throw std::runtime_error("Not an Avro object container file");
+    }
+
+    for (int64_t count = reader.read_long(); count != 0; count = reader.read_long()) {
+        if (count < 0) {
+            // a negative count is followed by the size of the block in bytes
+            count = -count;
+            reader.read_long();
+        }
+        for (int64_t i = 0; i < count; i++) {
+            string key = reader.read_string();
+            metadata[key] = reader.read_string();
+        }
+    }
+    const uint8_t* sync = reader.read(sync_size);
+
+    auto codec_entry = metadata.find("avro.codec");
+    if (codec_entry == metadata.end() || codec_entry->second == "null") {
+        codec = Codec::NULL_CODEC;
+    } else if (codec_entry->second == "deflate") {
+        codec = Codec::DEFLATE;
+    } else {
+        codec = Codec::UNSUPPORTED;
+    }
+
+    while (!reader.at_end()) {
+        Block block;
+        block.count = reader.read_long();
+        int64_t block_size = reader.read_long();
+        if (block.count < 0 || block_size < 0) {
+            throw std::runtime_error("Invalid block in Avro container");
+        }
+        block.size = block_size;
+        block.data = reader.read(block.size);
+        if (std::memcmp(reader.read(sync_size), sync, sync_size) != 0) {
+            throw std::runtime_error("Invalid sync marker in Avro container");
+        }
+        blocks.push_back(block);
+    }
+}
+
+const string& Container::schema() const {
+    auto schema_entry = metadata.find("avro.schema");
+    if (schema_entry == metadata.end()) {
+        throw std::runtime_error("Avro container has no schema");
+    }
+    return schema_entry->second;
+}
+
+// deflate blocks are raw (headerless) deflate streams
+static void inflate_block(const Block& block, vector<uint8_t>& output) {
+    z_stream stream;
+    std::memset(&stream, 0, sizeof(stream));
+    if (inflateInit2(&stream, -15) != Z_OK) {
+        throw std::runtime_error("Unable to initialize deflate decompression");
+    }
+    output.resize(std::max<size_t>(block.size * 4, 1024));
+    stream.next_in = const_cast<Bytef*>(block.data);
+    stream.avail_in = block.size;
+    int status = Z_OK;
+    while (status != Z_STREAM_END) {
+        if (stream.total_out == output.size()) {
+            output.resize(output.size() * 2);
+        }
+        stream.next_out = output.data() + stream.total_out;
+        stream.avail_out = output.size() - stream.total_out;
+        status = inflate(&stream, Z_NO_FLUSH);
+        if (status != Z_OK && status != Z_STREAM_END) {
+            inflateEnd(&stream);
+            throw std::runtime_error("Unable to decompress Avro block");
+        }
+    }
+    output.resize(stream.total_out);
+    inflateEnd(&stream);
+}
+
+const uint8_t* Container::block_data(const Block& block, vector<uint8_t>& output,
+                                     size_t& size) const {
+    switch (codec) {
+        case Codec::NULL_CODEC:
+            size = block.size;
+            return block.data;
+        case Codec::DEFLATE:
+            inflate_block(block, output);
+            size = output.size();
+            return output.data();
+        default:
+            throw std::runtime_error("Unsupported Avro codec");
+    }
+}
+
+}  // namespace avro
+}  // namespace bamboo
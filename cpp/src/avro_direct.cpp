@@ -17,90 +17,195 @@
 
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wdeprecated-declarations"
+#include <Compiler.hh>
 #include <DataFile.hh>
+#include <Stream.hh>
 #pragma GCC diagnostic pop
+#include <avro_container.hpp>
 #include <avro_direct.hpp>
-
-namespace ba = bamboo::avro;
+#include <boost/iostreams/device/array.hpp>
+#include <boost/iostreams/stream.hpp>
 
 namespace bamboo {
 namespace avro {
 namespace direct {
 
-// this union checking adds a non-inconsequential cost for tight loops on simple datamodels. it
-// would be better if we could check it with closer to zero cost (perhaps inside the type
-// classifier)
-static const CNode& resolve_if_union(const CNode& datum) {
-    if (datum.type() == AVRO_UNION) {
-        return resolve_union(datum);
-    }
-    return datum;
-}
-
-// should pull out the shared pieces of the avro decoder
-const CNode& AvroDirectConverter::read_union(const CNode& datum) {
-    return datum.leafAt(decoder.decodeUnionIndex());
-}
+// the counts of the input's blocks are read before any of their values are checked, so they are
+// only used as (capped) reservation hints, and a corrupt count cannot force a large allocation
+static constexpr size_t max_count_hint = 1 << 16;
 
-ObjType AvroDirectConverter::type(const CNode& datum) {
-    if (datum.type() == AVRO_UNION) {
-        return type(read_union(datum));
-    }
-    return ba::type(datum.type());
+size_t DecodePlan::add_op(OpCode code, unique_ptr<Node>& target) {
+    Op op = {};
+    op.code = code;
+    op.target = &target;
+    ops.push_back(std::move(op));
+    return ops.size() - 1;
 }
 
-FieldIterator AvroDirectConverter::fields(const CNode& datum) {
-    const CNode& resolved = resolve_if_union(datum);
-    // should handle out of order fields
-    if (resolved.type() == AVRO_RECORD) {
-        return FieldIterator(resolved);
-    } else {
-        throw std::invalid_argument("Expected record type");
-    }
-}
-
-ListIterator AvroDirectConverter::get_list(const CNode& datum) {
-    // should also handle map
-    const CNode& resolved = resolve_if_union(datum);
-    Type type = resolved.type();
-    if (type == AVRO_ARRAY) {
-        return ListIterator(decoder, datum);
-    } else if (type == AVRO_MAP) {
-        throw std::logic_error("Not implemented");
-    } else {
-        throw std::invalid_argument("Expected list type");
-    }
-}
-
-void AvroDirectConverter::add_primitive(PrimitiveNode& node, const CNode& datum) {
-    const CNode& resolved = resolve_if_union(datum);
-    ba::add_primitive(resolved, node, decoder);
-}
-
-// should share with FSM
-void initialize(const NodePtr& schema, unique_ptr<Node>& node) {
+void DecodePlan::compile(const NodePtr& schema, unique_ptr<Node>& target) {
+    size_t index;
     switch (schema->type()) {
         case AVRO_RECORD: {
-            node = make_unique<RecordNode>();
-            RecordNode& record_node = *static_cast<RecordNode*>(node.get());
+            index = add_op(OpCode::RECORD, target);
+            target = make_unique<RecordNode>();
+            RecordNode& record_node = *static_cast<RecordNode*>(target.get());
             for (size_t i = 0; i < schema->leaves(); i++) {
-                unique_ptr<Node>& field_node = record_node.get_field(schema->nameAt(i));
-                initialize(schema->leafAt(i), field_node);
+                compile(schema->leafAt(i), record_node.get_field(schema->nameAt(i)));
             }
             break;
         }
         case AVRO_ARRAY: {
-            node = make_unique<ListNode>();
-            ListNode& list_node = *static_cast<ListNode*>(node.get());
-            initialize(schema->leafAt(0), list_node.get_list());
+            index = add_op(OpCode::ARRAY, target);
+            target = make_unique<ListNode>();
+            ListNode& list_node = *static_cast<ListNode*>(target.get());
+            compile(schema->leafAt(0), list_node.get_list());
             break;
         }
         case AVRO_UNION: {
-            initialize(resolve_union(schema), node);
+            index = add_op(OpCode::NULLABLE, target);
+            ops[index].null_branch = null_branch(schema);
+            compile(resolve_union(schema), target);
             break;
         }
-        default:
+        case AVRO_MAP:
+            throw std::logic_error("Not implemented");
+        case AVRO_NULL:
+            index = add_op(OpCode::NULL_VALUE, target);
+            break;
+        case AVRO_BOOL:
+            index = add_op(OpCode::BOOL, target);
+            break;
+        case AVRO_INT:
+            index = add_op(OpCode::INT, target);
+            break;
+        case AVRO_LONG:
+            index = add_op(OpCode::LONG, target);
+            break;
+        case AVRO_FLOAT:
+            index = add_op(OpCode::FLOAT, target);
             break;
+        case AVRO_DOUBLE:
+            index = add_op(OpCode::DOUBLE, target);
+            break;
+        case AVRO_STRING:
+            index = add_op(OpCode::STRING, target);
+            break;
+        case AVRO_BYTES:
+            index = add_op(OpCode::BYTES, target);
+            break;
+        case AVRO_FIXED:
+            index = add_op(OpCode::FIXED, target);
+            ops[index].fixed_size = schema->fixedSize();
+            break;
+        case AVRO_ENUM:
+            index = add_op(OpCode::ENUM, target);
+            // shared by every value of the enum, so that they are recognized as the same enum
+            ops[index].enum_values = std::make_shared<AvroEnum>(schema);
+            break;
+        default:
+            throw std::runtime_error("Unexpected avro type");
+    }
+    ops[index].end = ops.size();
+}
+
+DecodePlan::DecodePlan(const NodePtr& schema, unique_ptr<Node>& target, Decoder& decoder)
+    : decoder(decoder) {
+    compile(schema, target);
+}
+
+// primitive nodes are only typed once their first (non-null) value is seen, consistent with the
+// other converters
+PrimitiveNode& DecodePlan::primitive(const Op& op) {
+    unique_ptr<Node>& target = *op.target;
+    if (target->type == ObjType::INCOMPLETE) {
+        init(target, ObjType::PRIMITIVE);
+    }
+    return *static_cast<PrimitiveNode*>(target.get());
+}
+
+void DecodePlan::run(size_t begin, size_t end) {
+    size_t pc = begin;
+    while (pc < end) {
+        const Op& op = ops[pc];
+        switch (op.code) {
+            case OpCode::RECORD:
+                // the fields follow directly
+                (*op.target)->add_not_null();
+                pc++;
+                continue;
+            case OpCode::ARRAY: {
+                ListNode& list_node = *static_cast<ListNode*>(op.target->get());
+                size_t length = 0;
+                for (size_t n = decoder.arrayStart(); n != 0; n = decoder.arrayNext()) {
+                    // the elements are written by the instruction directly after the array
+                    if (n > 1) {
+                        (*ops[pc + 1].target)->reserve(std::min(n, max_count_hint));
+                    }
+                    for (size_t i = 0; i < n; i++) {
+                        run(pc + 1, op.end);
+                    }
+                    length += n;
+                }
+                list_node.add_list(length);
+                list_node.add_not_null();
+                pc = op.end;
+                continue;
+            }
+            case OpCode::NULLABLE:
+                if (decoder.decodeUnionIndex() == op.null_branch) {
+                    decoder.decodeNull();
+                    (*op.target)->add_null();
+                    pc = op.end;
+                } else {
+                    pc++;
+                }
+                continue;
+            case OpCode::NULL_VALUE:
+                decoder.decodeNull();
+                (*op.target)->add_null();
+                pc++;
+                continue;
+            case OpCode::BOOL:
+                add_primitive<AVRO_BOOL>(primitive(op), decoder);
+                break;
+            case OpCode::INT:
+                add_primitive<AVRO_INT>(primitive(op), decoder);
+                break;
+            case OpCode::LONG:
+                add_primitive<AVRO_LONG>(primitive(op), decoder);
+                break;
+            case OpCode::FLOAT:
+                add_primitive<AVRO_FLOAT>(primitive(op), decoder);
+                break;
+            case OpCode::DOUBLE:
+                add_primitive<AVRO_DOUBLE>(primitive(op), decoder);
+                break;
+            case OpCode::STRING:
+                decoder.decodeString(scratch.str);
+                primitive(op).add_string(scratch.str.data(), scratch.str.size());
+                break;
+            case OpCode::BYTES:
+                decoder.decodeBytes(scratch.bytes);
+                primitive(op).add_by_type<PrimitiveType::BYTE_ARRAY>(scratch.bytes);
+                break;
+            case OpCode::FIXED:
+                decoder.decodeFixed(op.fixed_size, scratch.bytes);
+                primitive(op).add_fixed(scratch.bytes.data(), op.fixed_size);
+                break;
+            case OpCode::ENUM: {
+                PrimitiveNode& node = primitive(op);
+                size_t index = decoder.decodeEnum();
+                if (node.get_type() == PrimitiveType::EMPTY) {
+                    node.add(DynamicEnumValue(index, op.enum_values));
+                } else {
+                    node.get_vector()->get_typed_vector<PrimitiveType::ENUM>().add_index(index);
+                }
+                break;
+            }
+        }
+        // primitive values are a single instruction
+        (*op.target)->add_not_null();
+        pc++;
     }
 }
 
@@ -113,20 +218,14 @@ const NodePtr column_filtered(const NodePtr& schema, const ColumnFilter* column_
         return NodePtr();
     }
 
-    bool explicit_include = column_filter && column_filter->explicitly_include;
-    bool explicit_exclude = column_filter && column_filter->explicitly_exclude;
-    bool included = explicit_include || (implicit_include && !explicit_exclude);
+    bool included = ColumnFilter::included(column_filter, implicit_include);
 
     switch (schema->type()) {
         case AVRO_RECORD: {
             NodePtr node;
             for (size_t i = 0; i < schema->leaves(); i++) {
-                const ColumnFilter* field_filter = nullptr;
-                const string& field_name = schema->nameAt(i);
-                if (column_filter && column_filter->field_filters.count(field_name)) {
-                    field_filter = column_filter->field_filters.at(field_name).get();
-                }
-
+                const ColumnFilter* field_filter =
+                    ColumnFilter::child(column_filter, schema->nameAt(i));
                 const NodePtr field_schema =
                     column_filtered(schema->leafAt(i), field_filter, included);
                 if (field_schema) {
@@ -165,21 +264,25 @@ const NodePtr column_filtered(const ValidSchema& dataSchema,
                            !column_filter || !column_filter->has_includes());
 }
 
-unique_ptr<Node> convert(DataFileReaderBase& rb, boost::optional<const ValidSchema> schema) {
+// the container's per block record counts are not exposed by the reader, so only the user supplied
+// row count is used to reserve the columns
+unique_ptr<Node> convert(DataFileReaderBase& rb, boost::optional<const ValidSchema> schema,
+                         size_t expected_rows) {
     if (schema) {
         rb.init(schema.get());
     } else {
         rb.init();
     }
 
-    AvroDirectConverter converter(rb.decoder());
     unique_ptr<ListNode> node = make_unique<ListNode>();
-    initialize(rb.readerSchema().root(), node->get_list());
+    DecodePlan plan(rb.readerSchema().root(), node->get_list(), rb.decoder());
+    if (expected_rows) {
+        node->get_list()->reserve(expected_rows);
+    }
     size_t counter = 0;
-    const CNode cnode(rb.readerSchema().root());
     while (rb.hasMore()) {
         rb.decr();
-        converter.convert(node->get_list(), cnode);
+        plan.decode();
         counter++;
     }
     node->add_list(counter);
@@ -195,19 +298,149 @@ unique_ptr<Node> convert(DataFileReaderBase& rb, boost::optional<const ValidSche
 
 unique_ptr<Node> convert(std::istream& is, boost::optional<const ValidSchema> schema) {
     DataFileReaderBase rb(is, "unidentified stream");
-    return convert(rb, schema);
+    return convert(rb, schema, 0);
 }
 
-unique_ptr<Node> convert(std::istream& is, const ColumnFilter* column_filter) {
+unique_ptr<Node> convert_serial(std::istream& is, const ColumnFilter* column_filter,
+                                size_t expected_rows) {
     DataFileReaderBase rb(is, "unidentified stream");
     const NodePtr schema = column_filtered(rb.dataSchema(), column_filter);
     if (schema) {
-        return convert(rb, ValidSchema(schema));
+        return convert(rb, ValidSchema(schema), expected_rows);
     } else {
         return make_unique<IncompleteNode>();
     }
 }
 
+static vector<char> read_all(std::istream& is) {
+    constexpr size_t read_size = 1 << 20;
+    vector<char> buffer;
+    while (is) {
+        size_t size = buffer.size();
+        buffer.resize(size + read_size);
+        is.read(buffer.data() + size, read_size);
+        buffer.resize(size + is.gcount());
+    }
+    return buffer;
+}
+
+// a contiguous range of container blocks, decoded by one thread into its own node tree
+struct Shard {
+    size_t begin;
+    size_t end;
+    size_t rows = 0;
+    DecoderPtr decoder;
+    unique_ptr<Node> node = make_unique<IncompleteNode>();
+    unique_ptr<DecodePlan> plan;
+
+    Shard(size_t begin, size_t end) : begin(begin), end(end) {}
+
+    void decode(const Container& container) {
+        const vector<Block>& blocks = container.get_blocks();
+        vector<uint8_t> buffer;
+        for (size_t i = begin; i < end; i++) {
+            size_t size;
+            const uint8_t* data = container.block_data(blocks[i], buffer, size);
+            auto stream = memoryInputStream(data, size);
+            decoder->init(*stream);
+            for (int64_t j = 0; j < blocks[i].count; j++) {
+                plan->decode();
+            }
+        }
+    }
+};
+
+// splits the blocks into (at most) the given number of contiguous ranges of similar byte size
+static vector<Shard> split(const vector<Block>& blocks, size_t shards) {
+    size_t total = 0;
+    for (const Block& block : blocks) {
+        total += block.size;
+    }
+
+    vector<Shard> result;
+    size_t begin = 0;
+    size_t cumulative = 0;
+    for (size_t i = 0; i < blocks.size(); i++) {
+        cumulative += blocks[i].size;
+        if (cumulative * shards >= total * (result.size() + 1) || i + 1 == blocks.size()) {
+            result.emplace_back(begin, i + 1);
+            begin = i + 1;
+        }
+    }
+    return result;
+}
+
+// Decodes the blocks of the container in parallel (each thread decoding a contiguous range of
+// blocks into its own node tree) and concatenates the results in order. The blocks are decoded in
+// place (unless they are compressed).
+static unique_ptr<Node> convert_parallel(const char* data, size_t size,
+                                         const ColumnFilter* column_filter, size_t expected_rows,
+                                         size_t threads) {
+    Container container(reinterpret_cast<const uint8_t*>(data), size);
+    if (container.get_codec() == Codec::UNSUPPORTED) {
+        namespace io = boost::iostreams;
+        io::stream<io::array_source> serial_stream(data, size);
+        return convert_serial(serial_stream, column_filter, expected_rows);
+    }
+
+    const ValidSchema writer_schema = compileJsonSchemaFromString(container.schema());
+    const NodePtr schema = column_filtered(writer_schema, column_filter);
+    if (!schema) {
+        return make_unique<IncompleteNode>();
+    }
+    // the resolving decoder is only needed to skip the filtered columns
+    bool resolve = schema != writer_schema.root();
+    const ValidSchema reader_schema(schema);
+
+    vector<Shard> shards = split(container.get_blocks(), threads);
+    for (Shard& shard : shards) {
+        for (size_t i = shard.begin; i < shard.end; i++) {
+            shard.rows += container.get_blocks()[i].count;
+        }
+        shard.decoder = binaryDecoder();
+        if (resolve) {
+            shard.decoder = resolvingDecoder(writer_schema, reader_schema, shard.decoder);
+        }
+        shard.plan = bamboo::make_unique<DecodePlan>(reader_schema.root(), shard.node, *shard.decoder);
+        shard.node->reserve(std::min(shard.rows, max_count_hint));
+    }
+
+    parallel_for(shards.size(), [&](size_t i) { shards[i].decode(container); });
+
+    // compiling a plan gives the result the same record and list structure as the serial path (even
+    // when there are no records)
+    unique_ptr<ListNode> node = make_unique<ListNode>();
+    DecoderPtr structure_decoder = binaryDecoder();
+    DecodePlan structure(reader_schema.root(), node->get_list(), *structure_decoder);
+    size_t counter = 0;
+    for (Shard& shard : shards) {
+        concat(node->get_list(), *shard.node);
+        counter += shard.rows;
+    }
+    node->add_list(counter);
+    node->add_not_null();
+    return std::move(node);
+}
+
+unique_ptr<Node> convert(std::istream& is, const ColumnFilter* column_filter,
+                         size_t expected_rows, size_t threads) {
+    threads = thread_count(threads);
+    if (threads == 1) {
+        return convert_serial(is, column_filter, expected_rows);
+    }
+    // the whole stream is read into memory to locate the blocks (so the parallel path holds a copy
+    // of the file, as well as the decoded columns, until the conversion is done)
+    vector<char> buffer = read_all(is);
+    return convert_parallel(buffer.data(), buffer.size(), column_filter, expected_rows, threads);
+}
+
+unique_ptr<Node> convert(const char* data, size_t size, const ColumnFilter* column_filter,
+                         size_t expected_rows, size_t threads) {
+    // the blocks are already in memory, so even a single thread decodes them in place (rather than
+    // through the buffered reader)
+    return convert_parallel(data, size, column_filter, expected_rows, thread_count(threads));
+}
+
 unique_ptr<Node> convert(std::istream& is) {
     return convert(is, boost::optional<const ValidSchema>());
 }
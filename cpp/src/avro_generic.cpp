@@ -75,7 +75,8 @@ void AvroConverter::add_primitive(PrimitiveNode& v, const GenericDatum& datum) {
             v.add(d.value<AvroPrimitiveType<AVRO_LONG>::primitive_type>());
             break;
         case AVRO_FIXED: {
-            v.add(d.value<GenericFixed>().value());
+            const vector<uint8_t>& fixed = d.value<GenericFixed>().value();
+            v.add_fixed(fixed.data(), fixed.size());
             break;
         }
         case AVRO_FLOAT:
@@ -18,19 +18,25 @@
 #include <pybind11/numpy.h>
 #include <pybind11/pybind11.h>
 #include <pybind11/stl.h>
+#include <unistd.h>
+#include <algorithm>
 #include <arrow.hpp>
 #include <avro_direct.hpp>
 #include <avro_generic.hpp>
-#include <boost/iostreams/categories.hpp>
-#include <boost/iostreams/stream.hpp>
+#include <cerrno>
+#include <condition_variable>
+#include <cstring>
+#include <file.hpp>
 #include <iostream>
 #include <json.hpp>
+#include <json_index.hpp>
+#include <mutex>
+#include <parquet.hpp>
 #include <pbd.hpp>
+#include <thread>
 
 namespace py = pybind11;
-namespace io = boost::iostreams;
 
-using std::streamsize;
 using std::string;
 using std::vector;
 
@@ -38,30 +44,36 @@ namespace bamboo {
 
 template <class T, class F> class BufferVector {
    public:
-    vector<F>& vec;
+    F* data;
+    size_t size;
 
     // this const cast is required to expose the const (on the C++ side at
     // least) vector to the python side (which can technically break the
     // constness)
-    BufferVector(const vector<F>& vec) : vec(const_cast<vector<F>&>(vec)) {}
+    BufferVector(const vector<F>& vec) : BufferVector(vec.data(), vec.size()) {}
+
+    BufferVector(const F* data, size_t size) : data(const_cast<F*>(data)), size(size) {}
 
     py::buffer_info buffer() {
-        return py::buffer_info(vec.data(), sizeof(T), py::format_descriptor<T>::format(), 1,
-                               {vec.size() * sizeof(F) / sizeof(T)}, {sizeof(T)});
+        return py::buffer_info(data, sizeof(T), py::format_descriptor<T>::format(), 1,
+                               {size * sizeof(F) / sizeof(T)}, {sizeof(T)});
     }
 };
 
-py::array convert_strings(const std::vector<std::string>& str) {
+py::array convert_strings(BinaryVector& vec) {
     py::dtype obj = py::dtype("O");
+    const vector<int64_t>& offsets = vec.get_offsets();
+    const char* data = vec.get_data().data();
     vector<py::str> strc;
-    for (const string& s : str) {
-        strc.push_back(s);
+    strc.reserve(vec.size());
+    for (size_t i = 0; i < vec.size(); i++) {
+        strc.push_back(py::str(data + offsets[i], offsets[i + 1] - offsets[i]));
     }
     return py::array(obj, strc.size(), strc.data());
 }
 
 py::array get_strings(PrimitiveVector& vec) {
-    return convert_strings(vec.get_values<PrimitiveType::STRING>());
+    return convert_strings(vec.get_typed_vector<PrimitiveType::STRING>());
 };
 
 py::array get_node_strings(PrimitiveNode& node) {
@@ -85,27 +97,229 @@ template <class T> py::object s_as_array(const vector<T>& vec) {
     return as_array<T, T>(vec);
 }
 
+// a view of the values of a simple vector (including values it borrows from e.g. an Arrow array)
+template <PrimitiveType P, class T = typename VectorTyper<P>::vector_type::value_type>
+py::object values_as_array(PrimitiveVector& vec) {
+    auto& values = vec.get_typed_vector<P>();
+    typedef typename VectorTyper<P>::vector_type::value_type F;
+    return py::module::import("numpy").attr("array")(
+        BufferVector<T, F>(values.data(), values.size()), py::arg("copy") = false);
+}
+
+// views of the values of a simple vector, one for each run of values it holds (e.g. for each Arrow
+// record batch whose values are used in place), so that the runs need not be made contiguous
+template <PrimitiveType P, class T = typename VectorTyper<P>::vector_type::value_type>
+py::list value_runs_as_arrays(PrimitiveVector& vec) {
+    typedef typename VectorTyper<P>::vector_type::value_type F;
+    py::list arrays;
+    for (const auto& run : vec.get_typed_vector<P>().runs()) {
+        arrays.append(py::module::import("numpy").attr("array")(
+            BufferVector<T, F>(run.first, run.second), py::arg("copy") = false));
+    }
+    return arrays;
+}
+
+// the offsets and data buffers of a binary vector (in the layout of an Arrow large string array)
+py::tuple get_buffers(BinaryVector& vec) {
+    return py::make_tuple(s_as_array(vec.get_offsets()), as_array<uint8_t, char>(vec.get_data()));
+}
+
+py::tuple get_string_buffers(PrimitiveNode& node) {
+    return get_buffers(node.get_vector()->get_typed_vector<PrimitiveType::STRING>());
+};
+
+py::tuple get_binary_buffers(PrimitiveNode& node) {
+    return get_buffers(node.get_vector()->get_typed_vector<PrimitiveType::BYTE_ARRAY>());
+};
+
+// the values of a fixed width vector as an (n, width) uint8 view of its data, along with the width
+py::tuple get_fixed_buffer(PrimitiveNode& node) {
+    FixedBinaryVector& fixed =
+        node.get_vector()->get_typed_vector<PrimitiveType::FIXED_BYTE_ARRAY>();
+    py::object data = as_array<uint8_t, uint8_t>(fixed.get_data());
+    return py::make_tuple(data.attr("reshape")(fixed.size(), fixed.get_width()),
+                          fixed.get_width());
+};
+
 size_t get_size(NullIndicator& null_indicator) {
     return null_indicator.get_size();
 };
 
 py::object get_indices(NullIndicator& null_indicator) {
+    if (null_indicator.is_bitmap()) {
+        py::array_t<size_t> indices(null_indicator.get_null_count());
+        size_t* data = indices.mutable_data();
+        for (size_t i = 0, j = 0; i < null_indicator.get_size(); i++) {
+            if (null_indicator.is_null(i)) {
+                data[j++] = i;
+            }
+        }
+        return std::move(indices);
+    }
     return s_as_array(null_indicator.get_indices());
 };
 
+py::object get_null_bitmap(NullIndicator& null_indicator) {
+    return s_as_array(null_indicator.get_bitmap());
+};
+
+py::array_t<bool> get_not_null_mask(NullIndicator& null_indicator) {
+    size_t size = null_indicator.get_size();
+    py::array_t<bool> mask(size);
+    bool* data = mask.mutable_data();
+    if (null_indicator.is_bitmap()) {
+        const vector<uint8_t>& bitmap = null_indicator.get_bitmap();
+        for (size_t i = 0; i < size; i++) {
+            data[i] = bitmap[i / 8] & (1 << (i % 8));
+        }
+    } else {
+        std::fill(data, data + size, true);
+        for (size_t i : null_indicator.get_indices()) {
+            data[i] = false;
+        }
+    }
+    return mask;
+};
+
+template <class N, class... O> py::class_<N, O...>& def_nulls(py::class_<N, O...>& c) {
+    return c.def("get_size", [](N& node) { return get_size(node); })
+        .def("get_null_count", [](N& node) { return node.get_null_count(); })
+        .def("is_null_bitmap", [](N& node) { return node.is_bitmap(); })
+        .def("get_null_indices", [](N& node) { return get_indices(node); },
+             py::return_value_policy::reference_internal)
+        .def("get_null_bitmap", [](N& node) { return get_null_bitmap(node); },
+             py::return_value_policy::reference_internal)
+        .def("get_not_null_mask", [](N& node) { return get_not_null_mask(node); });
+}
+
 py::array get_bytes(PrimitiveVector& vec) {
     py::dtype obj = py::dtype("O");
-    const vector<vector<uint8_t>>& bytes = vec.get_values<PrimitiveType::BYTE_ARRAY>();
+    BinaryVector& bytes = vec.get_typed_vector<PrimitiveType::BYTE_ARRAY>();
+    const vector<int64_t>& offsets = bytes.get_offsets();
+    const char* data = bytes.get_data().data();
     vector<py::bytes> arr;
-    for (const vector<uint8_t>& b : bytes) {
-        string s(b.begin(), b.end());
-        arr.push_back(py::bytes(s));
+    arr.reserve(bytes.size());
+    for (size_t i = 0; i < bytes.size(); i++) {
+        arr.push_back(py::bytes(data + offsets[i], offsets[i + 1] - offsets[i]));
     }
     return py::array(obj, arr.size(), arr.data());
 }
 
+// fixed width values are exposed as exact bytes (a numpy fixed width bytes array would drop their
+// trailing zero bytes when they are read)
+py::array get_fixed(PrimitiveVector& vec) {
+    FixedBinaryVector& fixed = vec.get_typed_vector<PrimitiveType::FIXED_BYTE_ARRAY>();
+    size_t width = fixed.get_width();
+    const char* data = reinterpret_cast<const char*>(fixed.get_data().data());
+    vector<py::bytes> arr;
+    arr.reserve(fixed.size());
+    for (size_t i = 0; i < fixed.size(); i++) {
+        arr.push_back(py::bytes(data + i * width, width));
+    }
+    return py::array(py::dtype("O"), arr.size(), arr.data());
+}
+
+static string numpy_unit(TemporalUnit unit) {
+    switch (unit) {
+        case TemporalUnit::DAY:
+            return "D";
+        case TemporalUnit::SECOND:
+            return "s";
+        case TemporalUnit::MILLI:
+            return "ms";
+        case TemporalUnit::MICRO:
+            return "us";
+        case TemporalUnit::NANO:
+            return "ns";
+    }
+    throw std::runtime_error("Unknown temporal unit");
+}
+
+// temporal values are viewed as numpy datetimes (or timedeltas, for times of day) in their own
+// unit; numpy datetimes are always 64 bit, so only 32 bit values need to be converted
+template <PrimitiveType P> py::object get_temporal(PrimitiveVector& vec, const string& kind) {
+    typedef typename VectorTyper<P>::vector_type::value_type T;
+    string dtype = kind + "[" + numpy_unit(vec.get_typed_vector<P>().get_unit()) + "]";
+    py::object values = values_as_array<P>(vec);
+    return values.attr(sizeof(T) == sizeof(int64_t) ? "view" : "astype")(dtype);
+}
+
+// the time zone of a timestamp column (the values themselves are UTC), or None if it has none
+py::object get_timezone(PrimitiveNode& node) {
+    PrimitiveVector& vec = *node.get_vector();
+    if (vec.get_type() == PrimitiveType::TIMESTAMP) {
+        const string& timezone = vec.get_typed_vector<PrimitiveType::TIMESTAMP>().get_timezone();
+        if (!timezone.empty()) {
+            return py::str(timezone);
+        }
+    }
+    return py::none();
+}
+
+// the text of a 128 bit decimal (from its little endian, two's complement unscaled value), which
+// decimal.Decimal parses exactly, e.g. "-12345E-2" for -123.45
+static string decimal_text(const uint8_t* value, int32_t scale) {
+    uint64_t low;
+    uint64_t high;
+    std::memcpy(&low, value, sizeof(low));
+    std::memcpy(&high, value + sizeof(low), sizeof(high));
+    bool negative = high >> 63;
+    if (negative) {
+        // the magnitude of the two's complement value
+        low = ~low + 1;
+        high = ~high + (low == 0);
+    }
+    // the magnitude in 32 bit limbs (most significant first), divided by 10^9 until it is zero
+    uint32_t limbs[4] = {static_cast<uint32_t>(high >> 32), static_cast<uint32_t>(high),
+                         static_cast<uint32_t>(low >> 32), static_cast<uint32_t>(low)};
+    constexpr uint32_t divisor = 1000000000;
+    string digits;
+    bool zero;
+    do {
+        uint64_t remainder = 0;
+        zero = true;
+        for (uint32_t& limb : limbs) {
+            uint64_t current = remainder << 32 | limb;
+            limb = static_cast<uint32_t>(current / divisor);
+            remainder = current % divisor;
+            zero &= limb == 0;
+        }
+        // (the digits are collected least significant first)
+        for (int i = 0; i < 9; i++) {
+            digits.push_back(static_cast<char>('0' + remainder % 10));
+            remainder /= 10;
+        }
+    } while (!zero);
+    while (digits.size() > 1 && digits.back() == '0') {
+        digits.pop_back();
+    }
+    if (negative) {
+        digits.push_back('-');
+    }
+    std::reverse(digits.begin(), digits.end());
+    return digits + "E" + std::to_string(-static_cast<int64_t>(scale));
+}
+
+// numpy has no 128 bit decimal type, so decimals are exposed as an object array of
+// decimal.Decimal, which holds them exactly
+py::object get_decimals(PrimitiveVector& vec) {
+    DecimalVector& decimals = vec.get_typed_vector<PrimitiveType::DECIMAL128>();
+    const uint8_t* data = decimals.get_data().data();
+    py::object decimal = py::module::import("decimal").attr("Decimal");
+    vector<py::object> values;
+    values.reserve(decimals.size());
+    for (size_t i = 0; i < decimals.size(); i++) {
+        values.push_back(decimal(
+            decimal_text(data + i * DecimalVector::byte_width, decimals.get_scale())));
+    }
+    return py::array(py::dtype("O"), values.size(), values.data());
+}
+
+py::object extract_values(PrimitiveVector& vec);
+
+// the indices keep the width they were read with (e.g. the index type of an Arrow dictionary)
 py::object get_enum_indices(PrimitiveVector& vec) {
-    return s_as_array<size_t>(vec.get_enums().index);
+    return extract_values(*vec.get_enums().index);
 };
 
 py::object get_node_enum_indices(PrimitiveNode& node) {
@@ -114,6 +328,8 @@ py::object get_node_enum_indices(PrimitiveNode& node) {
 
 py::object get_enum_values(PrimitiveVector& vec);
 
+py::object get_categorical(PrimitiveVector& vec);
+
 template <class T, class F> void buffer(py::handle m) {
     const char* name = typeid(BufferVector<T, F>).name();
     // don't try to register the same buffer vectors twice (this can happen in the case of
@@ -128,97 +344,452 @@ template <class T> void sbuffer(py::handle m) {
     buffer<T, T>(m);
 };
 
-class PythonBufferStream {
+// Finds the file descriptor of a Python file object whose bytes are those of the descriptor: a raw
+// file (io.FileIO), or a buffered reader over one (whose position accounts for what it has
+// buffered, which is noted in buffered). Other objects with a descriptor (e.g. gzip or text files)
+// transform what they read from it, so -1 is returned for them.
+static int raw_file_descriptor(py::object stream, bool& buffered) {
+    py::module io = py::module::import("io");
+    buffered = py::isinstance(stream, io.attr("BufferedReader")) ||
+               py::isinstance(stream, io.attr("BufferedRandom"));
+    py::object raw = buffered ? stream.attr("raw") : stream;
+    if (!py::isinstance(raw, io.attr("FileIO"))) {
+        return -1;
+    }
+    return stream.attr("fileno")().cast<int>();
+}
+
+// Reads a stream ahead of the decoder on a native thread, into a ring of chunks that the decoder
+// reads in place, so that the decoder can run without the GIL. A Python stream is read with
+// readinto (the reading thread only takes the GIL for the call), unless it is a file that can be
+// read from its descriptor directly: a seekable file (read with pread, starting at the position
+// the stream reports) or an unbuffered pipe. A file opened from a path (e.g. a named pipe) is
+// always read directly.
+class PrefetchStreamBuffer : public std::streambuf {
+    static constexpr size_t chunk_size = 1 << 20;
+    static constexpr size_t chunk_count = 4;
+
+    struct Chunk {
+        unique_ptr<char[]> data = unique_ptr<char[]>(new char[chunk_size]);
+        size_t size = 0;
+    };
+
+    py::object stream;
+    unique_ptr<InputFile> file;
+    int fd = -1;
+    bool seekable = false;
+    int64_t offset = 0;
+    int64_t bytes_read = 0;
+    // the size of the chunks the decoder has finished with
+    int64_t bytes_consumed = 0;
+
+    // chunks [consumed, filled) (modulo the count) hold data; the decoder is reading the first of
+    // them if in_use is set
+    Chunk chunks[chunk_count];
+    size_t filled = 0;
+    size_t consumed = 0;
+    bool in_use = false;
+    bool eof = false;
+    bool stopping = false;
+    std::exception_ptr error;
+    std::mutex mutex;
+    std::condition_variable changed;
+    std::thread reader;
+
+    size_t fill(char* data) {
+        if (fd >= 0) {
+            ssize_t size;
+            do {
+                size = seekable ? pread(fd, data, chunk_size, offset + bytes_read)
+                                : read(fd, data, chunk_size);
+            } while (size < 0 && errno == EINTR);
+            if (size < 0) {
+                throw std::runtime_error(string("Unable to read input: ") + std::strerror(errno));
+            }
+            bytes_read += size;
+            return size;
+        }
+        py::gil_scoped_acquire gil;
+        py::buffer_info info(data, sizeof(char), py::format_descriptor<char>::format(), 1,
+                             {chunk_size}, {sizeof(char)});
+        py::memoryview mv(info);
+        size_t size = stream.attr("readinto")(mv).cast<size_t>();
+        bytes_read += size;
+        return size;
+    }
+
+    void read_ahead() {
+        try {
+            while (true) {
+                Chunk* chunk;
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    changed.wait(lock,
+                                 [this] { return stopping || filled - consumed < chunk_count; });
+                    if (stopping) {
+                        return;
+                    }
+                    chunk = &chunks[filled % chunk_count];
+                }
+                chunk->size = fill(chunk->data.get());
+                std::lock_guard<std::mutex> lock(mutex);
+                if (chunk->size == 0) {
+                    eof = true;
+                } else {
+                    filled++;
+                }
+                changed.notify_all();
+                if (eof) {
+                    return;
+                }
+            }
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(mutex);
+            error = std::current_exception();
+            changed.notify_all();
+        }
+    }
+
+   protected:
+    int_type underflow() override {
+        std::unique_lock<std::mutex> lock(mutex);
+        if (in_use) {
+            in_use = false;
+            bytes_consumed += chunks[consumed % chunk_count].size;
+            consumed++;
+            changed.notify_all();
+        }
+        changed.wait(lock, [this] { return filled > consumed || eof || error; });
+        if (filled > consumed) {
+            Chunk& chunk = chunks[consumed % chunk_count];
+            in_use = true;
+            setg(chunk.data.get(), chunk.data.get(), chunk.data.get() + chunk.size);
+            return traits_type::to_int_type(*gptr());
+        }
+        if (error) {
+            std::rethrow_exception(error);
+        }
+        return traits_type::eof();
+    }
+
    public:
-    typedef char char_type;
-    typedef io::source_tag category;
+    // must be called with the GIL held
+    PrefetchStreamBuffer(py::object stream) : stream(stream) {
+        try {
+            bool buffered;
+            int stream_fd = raw_file_descriptor(stream, buffered);
+            if (stream_fd < 0) {
+                return;
+            }
+            if (stream.attr("seekable")().cast<bool>()) {
+                // (a buffered file may have read past the position it reports)
+                offset = stream.attr("tell")().cast<int64_t>();
+                fd = stream_fd;
+                seekable = true;
+            } else if (!buffered) {
+                // (a buffered pipe may hold data that was already read from the descriptor)
+                fd = stream_fd;
+            }
+            if (fd >= 0) {
+                advise_sequential(fd, offset);
+            }
+        } catch (py::error_already_set&) {
+            // the stream has no file descriptor (e.g. an in memory stream)
+        }
+    }
 
-    PythonBufferStream(py::object& pystream)
-        : pystream(pystream), pystream_readinto(pystream.attr("readinto")) {}
+    PrefetchStreamBuffer(unique_ptr<InputFile> input_file)
+        : file(std::move(input_file)), fd(file->get_fd()) {
+        advise_sequential(fd, 0);
+    }
 
-    PythonBufferStream(const PythonBufferStream& other)
-        : pystream(other.pystream), pystream_readinto(other.pystream_readinto){};
+    void start() {
+        reader = std::thread(&PrefetchStreamBuffer::read_ahead, this);
+    }
 
-    streamsize read(char_type* s, streamsize n) {
-        py::buffer_info info(s, sizeof(char_type), py::format_descriptor<char_type>::format(), 1,
-                             {n}, {sizeof(char_type)});
-        py::memoryview mv(info);
-        streamsize num_read = pystream_readinto(mv).cast<streamsize>();
-        return num_read != 0 ? num_read : -1;
+    // must be called (without the GIL held, as the reader may be waiting for it) before the buffer
+    // is destroyed
+    void stop() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        changed.notify_all();
+        if (reader.joinable()) {
+            reader.join();
+        }
+    }
+
+    // leaves a file at the position after the data that the decoder read (as reading through the
+    // stream would have, rather than after what was read ahead of it), with the GIL held
+    void finish() {
+        if (seekable) {
+            int64_t position = offset + bytes_consumed;
+            if (in_use) {
+                position += gptr() - eback();
+            }
+            stream.attr("seek")(position);
+        }
     }
+};
 
-   private:
-    py::object& pystream;
-    const py::detail::str_attr_accessor pystream_readinto;
+// the whole input held in memory, which owner keeps alive
+struct MemoryInput {
+    const char* data;
+    size_t size;
+    std::shared_ptr<const void> owner;
 };
 
-constexpr size_t DEFAULT_BUFFER_SIZE = 65536;
-
-static auto convert(
-    std::function<unique_ptr<Node>(std::istream&, const ColumnFilter*)> converter) {
-    return
-        [converter](py::object stream, const ColumnFilter* column_filter) -> unique_ptr<Node> {
-            // the large buffer is necessary to amortize the cost of a
-            // locking stream buffer managed on the Python side (the larger the
-            // buffer, the fewer times we run python code)
-            io::stream<PythonBufferStream> is(PythonBufferStream(stream), DEFAULT_BUFFER_SIZE);
-            is.exceptions(std::istream::badbit);
-            return converter(is, column_filter);
-        };
+// requests the memory of a Python buffer (e.g. bytes, a memoryview, a numpy array or an mmap),
+// which must be contiguous
+static py::buffer_info contiguous_buffer(py::buffer& buffer) {
+    py::buffer_info info = buffer.request();
+    py::ssize_t stride = info.itemsize;
+    for (py::ssize_t i = info.ndim - 1; i >= 0; i--) {
+        if (info.shape[i] > 1 && info.strides[i] != stride) {
+            throw std::invalid_argument("Input buffer must be contiguous");
+        }
+        stride *= info.shape[i];
+    }
+    return info;
+}
+
+// the last reference to a Python buffer (e.g. from the values of an Arrow array read in place) may
+// be dropped without the GIL held
+static void release_buffer(py::buffer_info* info) {
+    py::gil_scoped_acquire gil;
+    delete info;
+}
+
+// Finds the memory holding the whole input if it can be read in place: a Python buffer, or (if
+// map_files is set) a regular file (given by its path, or as a raw or buffered file object, which
+// is then left at its end) that can be mapped. Otherwise a file opened from the path is left in
+// file to be read as a stream.
+static bool memory_input(py::object input, bool map_files, MemoryInput& memory,
+                         unique_ptr<InputFile>& file) {
+    if (PyObject_CheckBuffer(input.ptr())) {
+        py::buffer buffer = py::reinterpret_borrow<py::buffer>(input);
+        std::shared_ptr<py::buffer_info> info(new py::buffer_info(contiguous_buffer(buffer)),
+                                              release_buffer);
+        memory = {static_cast<const char*>(info->ptr),
+                  static_cast<size_t>(info->size * info->itemsize), info};
+        return true;
+    }
+
+    std::shared_ptr<MappedFile> mapped;
+    if (py::isinstance<py::str>(input)) {
+        file = bamboo::make_unique<InputFile>(input.cast<string>());
+        if (map_files) {
+            mapped = MappedFile::map(file->get_fd(), 0);
+        }
+        if (mapped) {
+            file.reset();
+        }
+    } else if (map_files) {
+        try {
+            bool buffered;
+            int fd = raw_file_descriptor(input, buffered);
+            if (fd >= 0 && input.attr("seekable")().cast<bool>()) {
+                int64_t offset = input.attr("tell")().cast<int64_t>();
+                mapped = MappedFile::map(fd, offset);
+                if (mapped) {
+                    input.attr("seek")(offset + mapped->get_size());
+                }
+            }
+        } catch (py::error_already_set&) {
+            // the stream has no file descriptor (e.g. an in memory stream)
+        }
+    }
+    if (!mapped) {
+        return false;
+    }
+    memory = {mapped->get_data(), mapped->get_size(), mapped};
+    return true;
+}
+
+// Wraps a converter taking a stream, a column filter and any further (converter specific)
+// arguments, along with one taking the whole input in memory (which is used where possible). Files
+// are only mapped for the memory converter if map_files is set, i.e. if the nodes it returns do not
+// borrow the input (a shared mapping would change under them if the file were later rewritten).
+// The input may be a path, a buffer or a Python stream. The GIL is released while converting, so
+// that other Python threads (including other conversions) can run.
+template <class M, class... Args>
+static auto convert(unique_ptr<Node> (*converter)(std::istream&, const ColumnFilter*, Args...),
+                    M memory_converter, bool map_files = true) {
+    return [converter, memory_converter, map_files](
+               py::object input, const ColumnFilter* column_filter,
+               Args... args) -> unique_ptr<Node> {
+        MemoryInput memory;
+        unique_ptr<InputFile> file;
+        if (memory_input(input, map_files, memory, file)) {
+            py::gil_scoped_release release;
+            return memory_converter(memory, column_filter, args...);
+        }
+
+        unique_ptr<PrefetchStreamBuffer> buffer =
+            file ? bamboo::make_unique<PrefetchStreamBuffer>(std::move(file))
+                 : bamboo::make_unique<PrefetchStreamBuffer>(input);
+        unique_ptr<Node> node;
+        {
+            py::gil_scoped_release release;
+            buffer->start();
+            try {
+                std::istream is(buffer.get());
+                is.exceptions(std::istream::badbit);
+                node = converter(is, column_filter, args...);
+            } catch (...) {
+                buffer->stop();
+                throw;
+            }
+            buffer->stop();
+        }
+        buffer->finish();
+        return node;
+    };
+}
+
+// adapts a converter taking input held in memory, a column filter and any further (converter
+// specific) arguments; the memory is only needed during the conversion
+template <class... Args>
+static auto in_place(unique_ptr<Node> (*converter)(const char*, size_t, const ColumnFilter*,
+                                                   Args...)) {
+    return [converter](const MemoryInput& input, const ColumnFilter* column_filter,
+                       Args... args) -> unique_ptr<Node> {
+        return converter(input.data, input.size, column_filter, args...);
+    };
+}
+
+// an Arrow buffer over memory input; the arrays read from it (and the nodes that use their values
+// in place) keep the memory alive until they are destroyed
+class MemoryArrowBuffer : public ::arrow::Buffer {
+    std::shared_ptr<const void> owner;
+
+   public:
+    MemoryArrowBuffer(const MemoryInput& input)
+        : ::arrow::Buffer(reinterpret_cast<const uint8_t*>(input.data), input.size),
+          owner(input.owner) {}
+};
+
+unique_ptr<Node> convert_arrow_memory(const MemoryInput& input, const ColumnFilter* column_filter,
+                                      size_t expected_rows) {
+    return bamboo::arrow::convert(std::make_shared<MemoryArrowBuffer>(input), column_filter,
+                                  expected_rows);
 }
 
 py::object extract_values(PrimitiveVector& vec) {
     // it would be nice if we could automatically map these
     switch (vec.get_type()) {
         case PrimitiveType::BOOL:
-            return as_array<bool, uint8_t>(vec.get_values<PrimitiveType::BOOL>());
+            return values_as_array<PrimitiveType::BOOL, bool>(vec);
         case PrimitiveType::CHAR:
-            return s_as_array(vec.get_values<PrimitiveType::CHAR>());
+            return values_as_array<PrimitiveType::CHAR>(vec);
         case PrimitiveType::UINT8:
-            return s_as_array(vec.get_values<PrimitiveType::UINT8>());
+            return values_as_array<PrimitiveType::UINT8>(vec);
         case PrimitiveType::UINT16:
-            return s_as_array(vec.get_values<PrimitiveType::UINT16>());
+            return values_as_array<PrimitiveType::UINT16>(vec);
         case PrimitiveType::UINT32:
-            return s_as_array(vec.get_values<PrimitiveType::UINT32>());
+            return values_as_array<PrimitiveType::UINT32>(vec);
         case PrimitiveType::UINT64:
-            return s_as_array(vec.get_values<PrimitiveType::UINT64>());
+            return values_as_array<PrimitiveType::UINT64>(vec);
         case PrimitiveType::INT8:
-            return s_as_array(vec.get_values<PrimitiveType::INT8>());
+            return values_as_array<PrimitiveType::INT8>(vec);
         case PrimitiveType::INT16:
-            return s_as_array(vec.get_values<PrimitiveType::INT16>());
+            return values_as_array<PrimitiveType::INT16>(vec);
         case PrimitiveType::INT32:
-            return s_as_array(vec.get_values<PrimitiveType::INT32>());
+            return values_as_array<PrimitiveType::INT32>(vec);
         case PrimitiveType::INT64:
-            return s_as_array(vec.get_values<PrimitiveType::INT64>());
+            return values_as_array<PrimitiveType::INT64>(vec);
         case PrimitiveType::FLOAT16:
-            return as_dtype(s_as_array(vec.get_values<PrimitiveType::FLOAT16>()), "float16");
+            return as_dtype(values_as_array<PrimitiveType::FLOAT16>(vec), "float16");
         case PrimitiveType::FLOAT32:
-            return s_as_array(vec.get_values<PrimitiveType::FLOAT32>());
+            return values_as_array<PrimitiveType::FLOAT32>(vec);
         case PrimitiveType::FLOAT64:
-            return s_as_array(vec.get_values<PrimitiveType::FLOAT64>());
+            return values_as_array<PrimitiveType::FLOAT64>(vec);
         case PrimitiveType::STRING:
             return get_strings(vec);
         case PrimitiveType::BYTE_ARRAY:
             return get_bytes(vec);
+        case PrimitiveType::FIXED_BYTE_ARRAY:
+            return get_fixed(vec);
         case PrimitiveType::ENUM:
-            return get_enum_values(vec).attr("__getitem__")(get_enum_indices(vec));
+            return get_categorical(vec);
+        case PrimitiveType::DATE32:
+            return get_temporal<PrimitiveType::DATE32>(vec, "datetime64");
+        case PrimitiveType::TIME32:
+            return get_temporal<PrimitiveType::TIME32>(vec, "timedelta64");
+        case PrimitiveType::TIME64:
+            return get_temporal<PrimitiveType::TIME64>(vec, "timedelta64");
+        case PrimitiveType::TIMESTAMP:
+            return get_temporal<PrimitiveType::TIMESTAMP>(vec, "datetime64");
+        case PrimitiveType::DECIMAL128:
+            return get_decimals(vec);
         default:
             throw std::runtime_error("Unknown primitive type");
     }
 }
 
+// the values of a numeric vector as a list of arrays (one for each run of values it holds); other
+// types are given as a single array of all of their values
+py::list extract_value_chunks(PrimitiveVector& vec) {
+    switch (vec.get_type()) {
+        case PrimitiveType::BOOL:
+            return value_runs_as_arrays<PrimitiveType::BOOL, bool>(vec);
+        case PrimitiveType::CHAR:
+            return value_runs_as_arrays<PrimitiveType::CHAR>(vec);
+        case PrimitiveType::UINT8:
+            return value_runs_as_arrays<PrimitiveType::UINT8>(vec);
+        case PrimitiveType::UINT16:
+            return value_runs_as_arrays<PrimitiveType::UINT16>(vec);
+        case PrimitiveType::UINT32:
+            return value_runs_as_arrays<PrimitiveType::UINT32>(vec);
+        case PrimitiveType::UINT64:
+            return value_runs_as_arrays<PrimitiveType::UINT64>(vec);
+        case PrimitiveType::INT8:
+            return value_runs_as_arrays<PrimitiveType::INT8>(vec);
+        case PrimitiveType::INT16:
+            return value_runs_as_arrays<PrimitiveType::INT16>(vec);
+        case PrimitiveType::INT32:
+            return value_runs_as_arrays<PrimitiveType::INT32>(vec);
+        case PrimitiveType::INT64:
+            return value_runs_as_arrays<PrimitiveType::INT64>(vec);
+        case PrimitiveType::FLOAT32:
+            return value_runs_as_arrays<PrimitiveType::FLOAT32>(vec);
+        case PrimitiveType::FLOAT64:
+            return value_runs_as_arrays<PrimitiveType::FLOAT64>(vec);
+        default: {
+            py::list arrays;
+            arrays.append(extract_values(vec));
+            return arrays;
+        }
+    }
+}
+
 py::object get_enum_values(PrimitiveVector& vec) {
     // TODO: because we don't take ownership of the unique_ptr to the enum values, it
     // appears that we have a dangling reference here
     return extract_values(vec.get_enums().values->get_enums());
 };
 
+// enums are exposed as a pandas Categorical over the (unexpanded) indices where possible (pandas
+// requires unique categories)
+py::object get_categorical(PrimitiveVector& vec) {
+    py::object pandas = py::module::import("pandas");
+    py::object values = get_enum_values(vec);
+    py::object indices = get_enum_indices(vec);
+    if (pandas.attr("Index")(values).attr("is_unique").cast<bool>()) {
+        return pandas.attr("Categorical").attr("from_codes")(indices, values);
+    }
+    return values.attr("__getitem__")(indices);
+}
+
 py::object get_node_enum_values(PrimitiveNode& node) {
     return get_enum_values(*node.get_vector());
 };
 
 static const py::arg stream_arg = py::arg("input_stream");
 static const py::arg_v column_filter_arg = py::arg("column_filter") = nullptr;
+static const py::arg_v expected_rows_arg = py::arg("expected_rows") = 0;
+static const py::arg_v schema_arg = py::arg("schema") = nullptr;
 
 PYBIND11_MODULE(bamboo_cpp_bind, m) {
     sbuffer<size_t>(m);
@@ -233,11 +804,12 @@ PYBIND11_MODULE(bamboo_cpp_bind, m) {
     sbuffer<float>(m);
     sbuffer<double>(m);
     buffer<bool, uint8_t>(m);
+    buffer<uint8_t, char>(m);
 
-    py::class_<ListNode>(m, "ListNode")
-        .def("get_size", [](ListNode& node) { return get_size(node); })
-        .def("get_null_indices", [](ListNode& node) { return get_indices(node); },
-             py::return_value_policy::reference_internal)
+    py::class_<Node>(m, "Node");
+
+    py::class_<ListNode, Node> list_node(m, "ListNode");
+    def_nulls(list_node)
         .def("get_index", [](ListNode& node) { return s_as_array(node.get_index()); },
              py::return_value_policy::reference_internal)
         .def("get_list", [](ListNode& node) -> Node& { return *node.get_list(); },
@@ -246,10 +818,8 @@ PYBIND11_MODULE(bamboo_cpp_bind, m) {
     py::class_<ColumnFilter, shared_ptr<ColumnFilter>>(m, "ColumnFilter")
         .def(py::init<bool, bool, const map<const string, const shared_ptr<ColumnFilter>>>());
 
-    py::class_<RecordNode>(m, "RecordNode")
-        .def("get_size", [](RecordNode& node) { return get_size(node); })
-        .def("get_null_indices", [](RecordNode& node) { return get_indices(node); },
-             py::return_value_policy::reference_internal)
+    py::class_<RecordNode, Node> record_node(m, "RecordNode");
+    def_nulls(record_node)
         .def("get_field",
              [](RecordNode& node, std::string name) -> Node& { return *node.get_field(name); },
              py::return_value_policy::reference_internal)
@@ -272,12 +842,16 @@ PYBIND11_MODULE(bamboo_cpp_bind, m) {
         .value("FLOAT64", PrimitiveType::FLOAT64)
         .value("STRING", PrimitiveType::STRING)
         .value("ENUM", PrimitiveType::ENUM)
-        .value("BYTE_ARRAY", PrimitiveType::BYTE_ARRAY);
-
-    py::class_<PrimitiveNode>(m, "PrimitiveNode")
-        .def("get_size", [](PrimitiveNode& node) { return get_size(node); })
-        .def("get_null_indices", [](PrimitiveNode& node) { return get_indices(node); },
-             py::return_value_policy::reference_internal)
+        .value("BYTE_ARRAY", PrimitiveType::BYTE_ARRAY)
+        .value("FIXED_BYTE_ARRAY", PrimitiveType::FIXED_BYTE_ARRAY)
+        .value("DATE32", PrimitiveType::DATE32)
+        .value("TIME32", PrimitiveType::TIME32)
+        .value("TIME64", PrimitiveType::TIME64)
+        .value("TIMESTAMP", PrimitiveType::TIMESTAMP)
+        .value("DECIMAL128", PrimitiveType::DECIMAL128);
+
+    py::class_<PrimitiveNode, Node> primitive_node(m, "PrimitiveNode");
+    def_nulls(primitive_node)
         .def("get_values",
              [](PrimitiveNode& node) -> py::object { return extract_values(*node.get_vector()); },
              py::return_value_policy::reference_internal)  // this is inconsistent -- some of the
@@ -285,25 +859,72 @@ PYBIND11_MODULE(bamboo_cpp_bind, m) {
                                                            // copies, some only create views; we may
                                                            // keep unneeded copies in memory for
                                                            // string values
+        .def("get_value_chunks",
+             [](PrimitiveNode& node) { return extract_value_chunks(*node.get_vector()); },
+             py::return_value_policy::reference_internal)
         .def("get_type", &PrimitiveNode::get_type)
+        .def("get_timezone", &get_timezone)
         .def("get_strings", &get_node_strings)
         .def("get_unicode_strings", &get_unicode_strings)
+        .def("get_string_buffers", &get_string_buffers,
+             py::return_value_policy::reference_internal)
+        .def("get_binary_buffers", &get_binary_buffers,
+             py::return_value_policy::reference_internal)
+        .def("get_fixed_buffer", &get_fixed_buffer, py::return_value_policy::reference_internal)
         .def("get_enum_values", &get_node_enum_values, py::return_value_policy::reference_internal)
         .def("get_enum_indices", &get_node_enum_indices,
              py::return_value_policy::reference_internal);
 
-    py::class_<IncompleteNode>(m, "IncompleteNode")
-        .def("get_size", [](IncompleteNode& node) { return get_size(node); })
-        .def("get_null_indices", [](IncompleteNode& node) { return get_indices(node); },
-             py::return_value_policy::reference_internal);
-
-    m.def("convert_avro", convert(bamboo::avro::direct::convert), stream_arg, column_filter_arg);
-
-    m.def("convert_arrow", convert(bamboo::arrow::convert), stream_arg, column_filter_arg);
-
-    m.def("convert_json", convert(bamboo::json::convert), stream_arg, column_filter_arg);
-
-    m.def("convert_pbd", convert(bamboo::pbd::convert), stream_arg, column_filter_arg);
+    py::class_<IncompleteNode, Node> incomplete_node(m, "IncompleteNode");
+    def_nulls(incomplete_node);
+
+    // the values of the given nodes are copied to the result (numpy arrays may already view the
+    // buffers of the given nodes, so they cannot be moved), leaving the given nodes as they were
+    m.def("concat",
+          [](const vector<Node*>& nodes) -> unique_ptr<Node> {
+              unique_ptr<Node> target = make_unique<IncompleteNode>();
+              for (Node* node : nodes) {
+                  concat(target, *copy_node(*node));
+              }
+              return target;
+          },
+          py::arg("nodes"));
+
+    // the input of the converters may be a path, a buffer or a Python stream
+    m.def("convert_avro",
+          convert(bamboo::avro::direct::convert, in_place(bamboo::avro::direct::convert)),
+          stream_arg, column_filter_arg, expected_rows_arg, py::arg("threads") = 1);
+
+    // (the nodes read from memory borrow the values of its arrays, so files are read rather than
+    // mapped)
+    m.def("convert_arrow", convert(bamboo::arrow::convert, convert_arrow_memory, false),
+          stream_arg, column_filter_arg, expected_rows_arg);
+
+    m.def("convert_arrow_file", &bamboo::arrow::convert_file, py::arg("path"), column_filter_arg,
+          py::arg("begin_batch") = 0, py::arg("end_batch") = -1, py::arg("threads") = 1,
+          py::call_guard<py::gil_scoped_release>());
+
+    m.def("convert_parquet", &bamboo::parquet::convert_file, py::arg("path"), column_filter_arg,
+          expected_rows_arg, py::arg("threads") = 1, py::call_guard<py::gil_scoped_release>());
+
+    // builds a schema for the JSON converters from an Avro schema (any node, such as one from an
+    // earlier conversion, may also be used as a schema)
+    m.def("json_schema", &bamboo::json::schema_from_avro, py::arg("avro_schema"));
+
+    m.def("convert_json", convert(bamboo::json::convert, in_place(bamboo::json::convert)),
+          stream_arg, column_filter_arg, schema_arg, expected_rows_arg);
+
+    m.def("convert_json_lines",
+          convert(bamboo::json::convert_lines, in_place(bamboo::json::convert_lines)), stream_arg,
+          column_filter_arg, schema_arg, expected_rows_arg, py::arg("threads") = 1);
+
+    // the block classifiers of the JSON indexer, so that each supported one can be tested
+    m.def("json_classifiers", &bamboo::json::classifiers);
+    m.def("get_json_classifier", &bamboo::json::get_classifier);
+    m.def("set_json_classifier", &bamboo::json::set_classifier, py::arg("name"));
+
+    m.def("convert_pbd", convert(bamboo::pbd::convert, in_place(bamboo::pbd::convert)), stream_arg,
+          column_filter_arg, expected_rows_arg);
 
 #ifdef VERSION_INFO
     m.attr("__version__") = VERSION_INFO;
@@ -16,6 +16,9 @@
 // limitations under the License.
 
 #include <columns.hpp>
+#include <cstring>
+#include <functional>
+#include <limits>
 
 namespace bamboo {
 
@@ -25,21 +28,436 @@ void PrimitiveEnumVector::add(const DynamicEnumValue& t) {
     }
 
     if (enums.values->same_source(*t.values)) {
-        enums.index.push_back(t.index);
+        add_index(t.index);
     } else {
         throw std::logic_error("Mixed enums not implemented");
     }
 }
 
+void BinaryVector::concat(PrimitiveVector& other) {
+    BinaryVector& source = static_cast<BinaryVector&>(other);
+    const vector<int64_t>& source_offsets = source.offsets.consolidate();
+    int64_t base = data.size();
+    int64_t* appended = offsets.extend(source_offsets.size() - 1);
+    for (size_t i = 1; i < source_offsets.size(); i++) {
+        appended[i - 1] = source_offsets[i] + base;
+    }
+    data.concat(std::move(source.data));
+}
+
+void FixedBinaryVector::concat(PrimitiveVector& other) {
+    FixedBinaryVector& source = static_cast<FixedBinaryVector&>(other);
+    if (source.width != width) {
+        throw std::invalid_argument("Mismatched fixed binary width");
+    }
+    data.concat(std::move(source.data));
+    count += source.count;
+}
+
+// the values of two enums combined (e.g. after a dictionary is replaced by one that does not extend
+// the previous one): the values of the first enum followed by the new values of the second
+struct MergedEnum final : public DynamicEnum {
+    unique_ptr<PrimitiveVector> values;
+
+    MergedEnum(unique_ptr<PrimitiveVector> values) : values(std::move(values)){};
+
+    virtual PrimitiveVector& get_enums() override {
+        return *values;
+    }
+
+    virtual const void* source() override {
+        return this;
+    }
+};
+
+static vector<string> enum_keys(BinaryVector& values) {
+    const vector<int64_t>& offsets = values.get_offsets();
+    const vector<char>& data = values.get_data();
+    vector<string> keys;
+    keys.reserve(values.size());
+    for (size_t i = 0; i < values.size(); i++) {
+        keys.emplace_back(data.data() + offsets[i], offsets[i + 1] - offsets[i]);
+    }
+    return keys;
+}
+
+template <class T> static vector<T> enum_keys(PrimitiveSimpleVector<T>& values) {
+    const T* data = values.data();
+    return vector<T>(data, data + values.size());
+}
+
+// adds the values of other that merged does not hold yet to merged, returning the index in merged
+// of each value of other
+template <class V> static vector<size_t> merge_values(V& merged, V& other) {
+    auto keys = enum_keys(merged);
+    map<typename decltype(keys)::value_type, size_t> indices;
+    for (size_t i = 0; i < keys.size(); i++) {
+        indices.emplace(keys[i], i);
+    }
+    vector<size_t> remap;
+    for (const auto& key : enum_keys(other)) {
+        auto inserted = indices.emplace(key, merged.size());
+        if (inserted.second) {
+            merged.add(key);
+        }
+        remap.push_back(inserted.first->second);
+    }
+    return remap;
+}
+
+template <PrimitiveType T>
+static vector<size_t> merge_typed(PrimitiveVector& merged, PrimitiveVector& other) {
+    return merge_values(merged.get_typed_vector<T>(), other.get_typed_vector<T>());
+}
+
+static shared_ptr<DynamicEnum> merge_enums(DynamicEnum& first, DynamicEnum& second,
+                                           vector<size_t>& remap) {
+    PrimitiveVector& other = second.get_enums();
+    unique_ptr<PrimitiveVector> merged = first.get_enums().copy();
+    if (merged->get_type() != other.get_type()) {
+        throw std::logic_error("Mixed enums not implemented");
+    }
+    switch (merged->get_type()) {
+        case PrimitiveType::STRING:
+            remap = merge_typed<PrimitiveType::STRING>(*merged, other);
+            break;
+        case PrimitiveType::BYTE_ARRAY:
+            remap = merge_typed<PrimitiveType::BYTE_ARRAY>(*merged, other);
+            break;
+        case PrimitiveType::CHAR:
+            remap = merge_typed<PrimitiveType::CHAR>(*merged, other);
+            break;
+        case PrimitiveType::INT8:
+            remap = merge_typed<PrimitiveType::INT8>(*merged, other);
+            break;
+        case PrimitiveType::INT16:
+            remap = merge_typed<PrimitiveType::INT16>(*merged, other);
+            break;
+        case PrimitiveType::INT32:
+            remap = merge_typed<PrimitiveType::INT32>(*merged, other);
+            break;
+        case PrimitiveType::INT64:
+            remap = merge_typed<PrimitiveType::INT64>(*merged, other);
+            break;
+        case PrimitiveType::UINT8:
+            remap = merge_typed<PrimitiveType::UINT8>(*merged, other);
+            break;
+        case PrimitiveType::UINT16:
+            remap = merge_typed<PrimitiveType::UINT16>(*merged, other);
+            break;
+        case PrimitiveType::UINT32:
+            remap = merge_typed<PrimitiveType::UINT32>(*merged, other);
+            break;
+        case PrimitiveType::UINT64:
+            remap = merge_typed<PrimitiveType::UINT64>(*merged, other);
+            break;
+        case PrimitiveType::FLOAT32:
+            remap = merge_typed<PrimitiveType::FLOAT32>(*merged, other);
+            break;
+        case PrimitiveType::FLOAT64:
+            remap = merge_typed<PrimitiveType::FLOAT64>(*merged, other);
+            break;
+        default:
+            throw std::logic_error("Mixed enums not implemented");
+    }
+    return std::make_shared<MergedEnum>(std::move(merged));
+}
+
+// calls f with the typed vector of an (integer) enum index
+template <class F> static void visit_index(PrimitiveVector& index, F&& f) {
+    switch (index.get_type()) {
+        case PrimitiveType::INT8:
+            return f(index.get_typed_vector<PrimitiveType::INT8>());
+        case PrimitiveType::INT16:
+            return f(index.get_typed_vector<PrimitiveType::INT16>());
+        case PrimitiveType::INT32:
+            return f(index.get_typed_vector<PrimitiveType::INT32>());
+        case PrimitiveType::INT64:
+            return f(index.get_typed_vector<PrimitiveType::INT64>());
+        case PrimitiveType::UINT8:
+            return f(index.get_typed_vector<PrimitiveType::UINT8>());
+        case PrimitiveType::UINT16:
+            return f(index.get_typed_vector<PrimitiveType::UINT16>());
+        case PrimitiveType::UINT32:
+            return f(index.get_typed_vector<PrimitiveType::UINT32>());
+        case PrimitiveType::UINT64:
+            return f(index.get_typed_vector<PrimitiveType::UINT64>());
+        default:
+            throw std::logic_error("Enum indices must be integers");
+    }
+}
+
+static vector<uint64_t> index_codes(PrimitiveVector& index) {
+    vector<uint64_t> codes;
+    visit_index(index, [&](auto& vec) {
+        const auto* data = vec.data();
+        codes.assign(data, data + vec.size());
+    });
+    return codes;
+}
+
+// appends the indices of source (into an enum that was merged into this one) mapped through remap
+void PrimitiveEnumVector::append_remapped(PrimitiveVector& source, const vector<size_t>& remap) {
+    size_t max_index = remap.empty() ? 0 : *std::max_element(remap.begin(), remap.end());
+    bool fits = true;
+    visit_index(*enums.index, [&](auto& vec) {
+        typedef typename std::decay<decltype(vec)>::type::value_type T;
+        fits = max_index <= static_cast<uint64_t>(std::numeric_limits<T>::max());
+    });
+    if (!fits) {
+        // the merged enum has more values than the indices can address
+        vector<uint64_t> codes = index_codes(*enums.index);
+        unique_ptr<PrimitiveSimpleVector<int64_t>> widened =
+            make_unique<PrimitiveSimpleVector<int64_t>>(PrimitiveType::INT64);
+        std::copy(codes.begin(), codes.end(), widened->extend(codes.size()));
+        enums.index = std::move(widened);
+    }
+
+    vector<uint64_t> codes = index_codes(source);
+    visit_index(*enums.index, [&](auto& vec) {
+        typedef typename std::decay<decltype(vec)>::type::value_type T;
+        T* appended = vec.extend(codes.size());
+        for (size_t i = 0; i < codes.size(); i++) {
+            if (codes[i] >= remap.size()) {
+                throw std::out_of_range("Enum index out of range");
+            }
+            appended[i] = static_cast<T>(remap[codes[i]]);
+        }
+    });
+}
+
+void PrimitiveEnumVector::concat(PrimitiveVector& other) {
+    DynamicEnumVector& source = static_cast<PrimitiveEnumVector&>(other).enums;
+    if (!enums.values) {
+        enums.values = source.values;
+    } else if (source.values && !enums.values->extends(*source.values)) {
+        if (source.values->extends(*enums.values)) {
+            enums.values = source.values;
+        } else {
+            // neither enum extends the other (e.g. a replaced dictionary), so the indices of the
+            // source are mapped to the values of an enum combining the two
+            vector<size_t> remap;
+            shared_ptr<DynamicEnum> merged = merge_enums(*enums.values, *source.values, remap);
+            append_remapped(*source.index, remap);
+            enums.values = merged;
+            return;
+        }
+    }
+    if (enums.index->get_type() != source.index->get_type()) {
+        throw std::logic_error("Mismatched enum index types");
+    }
+    enums.index->concat(*source.index);
+}
+
+unique_ptr<PrimitiveVector> PrimitiveEnumVector::copy() const {
+    DynamicEnumVector copied;
+    copied.index = enums.index->copy();
+    copied.values = enums.values;
+    return make_unique<PrimitiveEnumVector>(std::move(copied));
+}
+
+constexpr size_t NullIndicator::min_bitmap_nulls;
+constexpr size_t DecimalVector::byte_width;
+
+// sets the length bits starting at bit offset
+static void set_bits(uint8_t* bits, size_t offset, size_t length) {
+    size_t i = offset;
+    size_t end = offset + length;
+    for (; i < end && i % 8; i++) {
+        bits[i / 8] |= 1 << (i % 8);
+    }
+    if (end - i >= 8) {
+        std::memset(bits + i / 8, 0xFF, (end - i) / 8);
+        i += (end - i) / 8 * 8;
+    }
+    for (; i < end; i++) {
+        bits[i / 8] |= 1 << (i % 8);
+    }
+}
+
+// ors length bits of source (starting at bit source_offset) into target (starting at bit
+// target_offset)
+static void copy_bits(const uint8_t* source, size_t source_offset, uint8_t* target,
+                      size_t target_offset, size_t length) {
+    if (source_offset % 8 == 0 && target_offset % 8 == 0) {
+        const uint8_t* begin = source + source_offset / 8;
+        uint8_t* out = target + target_offset / 8;
+        std::transform(begin, begin + length / 8, out, out, std::bit_or<uint8_t>());
+        for (size_t i = length / 8 * 8; i < length; i++) {
+            if (begin[i / 8] & (1 << (i % 8))) {
+                out[i / 8] |= 1 << (i % 8);
+            }
+        }
+        return;
+    }
+    for (size_t i = 0; i < length; i++) {
+        size_t j = source_offset + i;
+        if (source[j / 8] & (1 << (j % 8))) {
+            size_t k = target_offset + i;
+            target[k / 8] |= 1 << (k % 8);
+        }
+    }
+}
+
+void NullIndicator::switch_to_bitmap() {
+    bitmap.reserve((std::max(size, expected_size) + 7) / 8);
+    bitmap.assign((size + 7) / 8, 0xFF);
+    if (size % 8) {
+        bitmap.back() = (1 << (size % 8)) - 1;
+    }
+    for (size_t i : index) {
+        bitmap[i / 8] &= ~(1 << (i % 8));
+    }
+    vector<size_t>().swap(index);
+    use_bitmap = true;
+}
+
 void NullIndicator::add_null() {
-    index.push_back(size);
+    if (use_bitmap) {
+        if (size % 8 == 0) {
+            bitmap.push_back(0);
+        }
+    } else {
+        index.push_back(size);
+    }
     size++;
+    null_count++;
+    // the index list costs sizeof(size_t) bytes per null, the bitmap costs one bit per value
+    if (!use_bitmap && null_count >= min_bitmap_nulls &&
+        null_count * sizeof(size_t) * 8 > size) {
+        switch_to_bitmap();
+    }
 }
 
 void NullIndicator::add_not_null() {
+    if (use_bitmap) {
+        if (size % 8 == 0) {
+            bitmap.push_back(0);
+        }
+        bitmap.back() |= 1 << (size % 8);
+    }
     size++;
 }
 
+void NullIndicator::append(const NullIndicator& other) {
+    if (!use_bitmap && !other.use_bitmap) {
+        reserve_more(index, other.index.size());
+        for (size_t i : other.index) {
+            index.push_back(size + i);
+        }
+        size += other.size;
+        null_count += other.null_count;
+        if (null_count >= min_bitmap_nulls && null_count * sizeof(size_t) * 8 > size) {
+            switch_to_bitmap();
+        }
+        return;
+    }
+
+    if (!use_bitmap) {
+        switch_to_bitmap();
+    }
+    size_t offset = size;
+    size += other.size;
+    null_count += other.null_count;
+    bitmap.resize((size + 7) / 8, 0);
+    if (other.use_bitmap) {
+        copy_bits(other.bitmap.data(), 0, bitmap.data(), offset, other.size);
+    } else {
+        set_bits(bitmap.data(), offset, other.size);
+        for (size_t i : other.index) {
+            size_t j = offset + i;
+            bitmap[j / 8] &= ~(1 << (j % 8));
+        }
+    }
+}
+
+void NullIndicator::append_validity(const uint8_t* validity, size_t offset, size_t length,
+                                    size_t nulls) {
+    NullIndicator other;
+    other.size = length;
+    if (validity && nulls) {
+        other.null_count = nulls;
+        if (use_bitmap || (nulls >= min_bitmap_nulls && nulls * sizeof(size_t) * 8 > length)) {
+            other.use_bitmap = true;
+            other.bitmap.assign((length + 7) / 8, 0);
+            copy_bits(validity, offset, other.bitmap.data(), 0, length);
+        } else {
+            other.index.reserve(nulls);
+            for (size_t i = 0; i < length; i++) {
+                size_t j = offset + i;
+                if (!(validity[j / 8] & (1 << (j % 8)))) {
+                    other.index.push_back(i);
+                }
+            }
+        }
+    }
+    append(other);
+}
+
+void NullIndicator::reserve(size_t additional) {
+    expected_size = std::max(expected_size, size + additional);
+    if (use_bitmap) {
+        reserve_more(bitmap, (expected_size + 7) / 8 - bitmap.size());
+    }
+}
+
+void NullIndicator::truncate(size_t length) {
+    if (length >= size) {
+        return;
+    }
+    if (use_bitmap) {
+        for (size_t i = length; i < size; i++) {
+            if (!(bitmap[i / 8] & (1 << (i % 8)))) {
+                null_count--;
+            }
+        }
+        bitmap.resize((length + 7) / 8);
+        if (length % 8) {
+            bitmap.back() &= (1 << (length % 8)) - 1;
+        }
+    } else {
+        index.erase(std::lower_bound(index.begin(), index.end(), length), index.end());
+        null_count = index.size();
+    }
+    size = length;
+}
+
+bool NullIndicator::is_null(size_t i) const {
+    if (use_bitmap) {
+        return !(bitmap[i / 8] & (1 << (i % 8)));
+    } else {
+        return std::binary_search(index.begin(), index.end(), i);
+    }
+}
+
+const vector<size_t>& NullIndicator::get_indices() {
+    if (use_bitmap) {
+        throw std::logic_error("Attempted to access null indices of a bitmap null indicator");
+    }
+    return index;
+}
+
+const vector<uint8_t>& NullIndicator::get_bitmap() {
+    if (!use_bitmap) {
+        throw std::logic_error("Attempted to access null bitmap of an index null indicator");
+    }
+    return bitmap;
+}
+
+void PrimitiveNode::concat_values(PrimitiveNode& other) {
+    if (other.values->type == PrimitiveType::EMPTY) {
+        return;
+    }
+    if (values->type == PrimitiveType::EMPTY) {
+        values = std::move(other.values);
+    } else if (values->type == other.values->type) {
+        values->concat(*other.values);
+    } else {
+        throw std::invalid_argument("Mismatched primitive types");
+    }
+    other.values = make_unique<PrimitiveVector>();
+}
+
 const DynamicEnumVector& PrimitiveVector::get_enums() {
     if (type == PrimitiveType::ENUM) {
         return static_cast<PrimitiveEnumVector&>(*this).get_enums_vector();
@@ -49,7 +467,7 @@ const DynamicEnumVector& PrimitiveVector::get_enums() {
 }
 
 
-PrimitiveType PrimitiveNode::get_type() {
+PrimitiveType PrimitiveNode::get_type() const {
     return values->type;
 }
 
@@ -57,47 +475,298 @@ unique_ptr<PrimitiveVector>& PrimitiveNode::get_vector() {
     return values;
 }
 
+const unique_ptr<PrimitiveVector>& PrimitiveNode::get_vector() const {
+    return values;
+}
+
 unique_ptr<Node>& ListNode::get_list() {
     return child;
 }
 
+const unique_ptr<Node>& ListNode::get_list() const {
+    return child;
+}
+
 void ListNode::add_list(size_t length) {
     index.push_back(length);
 };
 
+void ListNode::concat_index(ListNode& other) {
+    index.insert(index.end(), other.index.begin(), other.index.end());
+    vector<size_t>().swap(other.index);
+}
+
+size_t ListNode::truncate_index(size_t size) {
+    size_t dropped = 0;
+    for (size_t i = size; i < index.size(); i++) {
+        dropped += index[i];
+    }
+    if (size < index.size()) {
+        index.resize(size);
+    }
+    return dropped;
+}
+
+void ListNode::reserve(size_t additional) {
+    Node::reserve(additional);
+    reserve_more(index, additional);
+}
+
 const vector<size_t>& ListNode::get_index() {
     return index;
 }
 
-void RecordNode::add_field(const string& name) {
-    fields_map[name] = make_unique<IncompleteNode>();
-    field_vec.push_back(reference_wrapper<unique_ptr<Node>>(fields_map[name]));
-    field_names.push_back(name);
+const vector<size_t>& ListNode::get_index() const {
+    return index;
+}
+
+// FNV-1a
+static size_t hash_name(const char* name, size_t length) {
+    uint64_t hash = 14695981039346656037ULL;
+    for (size_t i = 0; i < length; i++) {
+        hash ^= static_cast<uint8_t>(name[i]);
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+bool RecordNode::slot_matches(size_t slot, const char* name, size_t length) const {
+    const string& field_name = field_names[slot];
+    return field_name.size() == length && std::memcmp(field_name.data(), name, length) == 0;
+}
+
+void RecordNode::insert_bucket(size_t slot) {
+    size_t mask = buckets.size() - 1;
+    const string& name = field_names[slot];
+    size_t bucket = hash_name(name.data(), name.size()) & mask;
+    while (buckets[bucket]) {
+        bucket = (bucket + 1) & mask;
+    }
+    buckets[bucket] = slot + 1;
+}
+
+size_t RecordNode::add_field(const char* name, size_t length) {
+    size_t slot = field_names.size();
+    slots.push_back(make_unique<IncompleteNode>());
+    field_names.emplace_back(name, length);
+    // a field first seen after a reservation is given the rest of it
+    if (get_expected_size() > get_size()) {
+        slots.back()->reserve(get_expected_size() - get_size());
+    }
+
+    // keep the load factor at or below one half
+    if (field_names.size() * 2 > buckets.size()) {
+        buckets.assign(std::max<size_t>(8, buckets.size() * 2), 0);
+        for (size_t i = 0; i < field_names.size(); i++) {
+            insert_bucket(i);
+        }
+    } else {
+        insert_bucket(slot);
+    }
+    return slot;
 }
 
 RecordNode::RecordNode(vector<string> names) : RecordNode() {
     for (const string& name : names) {
-        add_field(name);
+        get_slot(name.data(), name.size());
+    }
+}
+
+size_t RecordNode::get_slot(const char* name, size_t length) {
+    size_t slot;
+    if (next_slot < field_names.size() && slot_matches(next_slot, name, length)) {
+        slot = next_slot;
+    } else {
+        slot = field_names.size();
+        if (!buckets.empty()) {
+            size_t mask = buckets.size() - 1;
+            size_t bucket = hash_name(name, length) & mask;
+            while (buckets[bucket]) {
+                if (slot_matches(buckets[bucket] - 1, name, length)) {
+                    slot = buckets[bucket] - 1;
+                    break;
+                }
+                bucket = (bucket + 1) & mask;
+            }
+        }
+        if (slot == field_names.size()) {
+            add_field(name, length);
+        }
     }
+    next_slot = slot + 1;
+    return slot;
 }
 
 unique_ptr<Node>& RecordNode::get_field(size_t index) {
-    return field_vec[index];
+    return slots[index];
+}
+
+const unique_ptr<Node>& RecordNode::get_field(size_t index) const {
+    return slots[index];
+}
+
+unique_ptr<Node>& RecordNode::get_field(const char* name, size_t length) {
+    return slots[get_slot(name, length)];
 }
 
 unique_ptr<Node>& RecordNode::get_field(const string& name) {
-    // for those formats that have a schema, we could probably find a way to
-    // optimize away this check
-    unique_ptr<Node>& node_field = fields_map[name];
-    if (!node_field) {
-        add_field(name);
-    }
-    return node_field;
+    return get_field(name.data(), name.size());
 }
 
-const vector<string> RecordNode::get_fields() {
-    // return keys(fields_map);
+size_t RecordNode::get_field_count() const {
+    return field_names.size();
+}
+
+const vector<string>& RecordNode::get_fields() const {
     return field_names;
 }
 
+void RecordNode::reserve(size_t additional) {
+    Node::reserve(additional);
+    for (unique_ptr<Node>& field : slots) {
+        field->reserve(additional);
+    }
+}
+
+static void add_nulls(Node& node, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        node.add_null();
+    }
+}
+
+// the children of a node only hold entries for its non-null entries
+static size_t not_null_count(Node& node) {
+    return node.get_size() - node.get_null_count();
+}
+
+void concat(unique_ptr<Node>& target, Node& source) {
+    if (target->type == ObjType::INCOMPLETE) {
+        init(target, source.type);
+    } else if (source.type != ObjType::INCOMPLETE && source.type != target->type) {
+        throw std::invalid_argument("Inconsistent schema");
+    }
+
+    size_t target_rows = not_null_count(*target);
+    size_t source_rows = not_null_count(source);
+    target->append(source);
+    static_cast<NullIndicator&>(source) = NullIndicator();
+
+    switch (target->type) {
+        case ObjType::RECORD: {
+            RecordNode& target_record = static_cast<RecordNode&>(*target);
+            size_t target_fields = target_record.get_field_count();
+            vector<bool> in_source(target_fields, false);
+            if (source.type == ObjType::RECORD) {
+                RecordNode& source_record = static_cast<RecordNode&>(source);
+                const vector<string>& names = source_record.get_fields();
+                for (size_t i = 0; i < names.size(); i++) {
+                    size_t slot = target_record.get_slot(names[i].data(), names[i].size());
+                    unique_ptr<Node>& field = target_record.get_field(slot);
+                    if (slot < target_fields) {
+                        in_source[slot] = true;
+                    } else {
+                        // a field the target has not seen is null for all of its existing entries
+                        add_nulls(*field, target_rows);
+                    }
+                    concat(field, *source_record.get_field(i));
+                }
+            }
+            for (size_t slot = 0; slot < target_fields; slot++) {
+                if (!in_source[slot]) {
+                    add_nulls(*target_record.get_field(slot), source_rows);
+                }
+            }
+            break;
+        }
+        case ObjType::LIST:
+            if (source.type == ObjType::LIST) {
+                ListNode& target_list = static_cast<ListNode&>(*target);
+                ListNode& source_list = static_cast<ListNode&>(source);
+                target_list.concat_index(source_list);
+                concat(target_list.get_list(), *source_list.get_list());
+            }
+            break;
+        case ObjType::PRIMITIVE:
+            if (source.type == ObjType::PRIMITIVE) {
+                static_cast<PrimitiveNode&>(*target).concat_values(
+                    static_cast<PrimitiveNode&>(source));
+            }
+            break;
+        case ObjType::INCOMPLETE:
+            break;
+    }
+}
+
+void truncate(Node& node, size_t size) {
+    if (size >= node.get_size()) {
+        return;
+    }
+    node.NullIndicator::truncate(size);
+    size_t rows = not_null_count(node);
+
+    switch (node.type) {
+        case ObjType::RECORD: {
+            RecordNode& record = static_cast<RecordNode&>(node);
+            for (size_t i = 0; i < record.get_field_count(); i++) {
+                truncate(*record.get_field(i), rows);
+            }
+            break;
+        }
+        case ObjType::LIST: {
+            ListNode& list = static_cast<ListNode&>(node);
+            size_t dropped = list.truncate_index(rows);
+            Node& child = *list.get_list();
+            truncate(child, child.get_size() - dropped);
+            break;
+        }
+        case ObjType::PRIMITIVE: {
+            PrimitiveNode& primitive = static_cast<PrimitiveNode&>(node);
+            if (primitive.get_type() != PrimitiveType::EMPTY) {
+                primitive.get_vector()->truncate(rows);
+            }
+            break;
+        }
+        case ObjType::INCOMPLETE:
+            break;
+    }
+}
+
+unique_ptr<Node> copy_node(const Node& node) {
+    unique_ptr<Node> copied;
+    switch (node.type) {
+        case ObjType::RECORD: {
+            const RecordNode& record = static_cast<const RecordNode&>(node);
+            unique_ptr<RecordNode> copied_record =
+                bamboo::make_unique<RecordNode>(record.get_fields());
+            for (size_t i = 0; i < record.get_field_count(); i++) {
+                copied_record->get_field(i) = copy_node(*record.get_field(i));
+            }
+            copied = std::move(copied_record);
+            break;
+        }
+        case ObjType::LIST: {
+            const ListNode& list = static_cast<const ListNode&>(node);
+            unique_ptr<ListNode> copied_list = make_unique<ListNode>();
+            for (size_t length : list.get_index()) {
+                copied_list->add_list(length);
+            }
+            copied_list->get_list() = copy_node(*list.get_list());
+            copied = std::move(copied_list);
+            break;
+        }
+        case ObjType::PRIMITIVE: {
+            const PrimitiveNode& primitive = static_cast<const PrimitiveNode&>(node);
+            unique_ptr<PrimitiveNode> copied_primitive = make_unique<PrimitiveNode>();
+            copied_primitive->get_vector() = primitive.get_vector()->copy();
+            copied = std::move(copied_primitive);
+            break;
+        }
+        case ObjType::INCOMPLETE:
+            copied = make_unique<IncompleteNode>();
+            break;
+    }
+    static_cast<NullIndicator&>(*copied) = node;
+    return copied;
+}
+
 }  // namespace bamboo_cpp
@@ -0,0 +1,79 @@
+// Copyright (c) 2019 Michael Vilim
+//
+// This file is part of the bamboo library. It is currently hosted at
+// https://github.com/mvilim/bamboo
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#include <file.hpp>
+#include <stdexcept>
+
+namespace bamboo {
+
+InputFile::InputFile(const string& path) {
+    do {
+        fd = open(path.c_str(), O_RDONLY);
+    } while (fd < 0 && errno == EINTR);
+    if (fd < 0) {
+        throw std::runtime_error("Unable to open " + path + ": " + std::strerror(errno));
+    }
+}
+
+InputFile::~InputFile() {
+    close(fd);
+}
+
+void advise_sequential(int fd, int64_t offset) {
+#ifdef POSIX_FADV_SEQUENTIAL
+    posix_fadvise(fd, offset, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+}
+
+unique_ptr<MappedFile> MappedFile::map(int fd, int64_t offset) {
+    struct stat file_stat;
+    // (an empty mapping is not allowed, and some special files, e.g. in /proc, report no size but
+    // can still be read)
+    if (fstat(fd, &file_stat) != 0 || !S_ISREG(file_stat.st_mode) || offset < 0 ||
+        offset >= file_stat.st_size) {
+        return nullptr;
+    }
+
+    unique_ptr<MappedFile> file(new MappedFile());
+    file->size = file_stat.st_size - offset;
+    // the mapping has to start on a page boundary
+    size_t page_offset = offset % sysconf(_SC_PAGESIZE);
+    file->mapping_size = file->size + page_offset;
+    void* mapping =
+        mmap(nullptr, file->mapping_size, PROT_READ, MAP_SHARED, fd, offset - page_offset);
+    if (mapping == MAP_FAILED) {
+        return nullptr;
+    }
+    file->mapping = mapping;
+    file->data = static_cast<const char*>(mapping) + page_offset;
+    advise_sequential(fd, offset);
+    madvise(mapping, file->mapping_size, MADV_SEQUENTIAL);
+    return file;
+}
+
+MappedFile::~MappedFile() {
+    if (mapping) {
+        munmap(mapping, mapping_size);
+    }
+}
+
+}  // namespace bamboo
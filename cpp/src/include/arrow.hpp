@@ -34,12 +34,46 @@ class ArrowInputStream : public virtual ::arrow::io::InputStream {
    private:
     std::istream& stream;
     int64_t pos = 0;
+    // the bytes read while recording, which are read again after a replay
+    bool recording = false;
+    vector<char> recorded;
+    size_t replay_pos = 0;
+
+    int64_t read_stream(int64_t nbytes, char* out) {
+        int64_t replayed = std::min<int64_t>(nbytes, recorded.size() - replay_pos);
+        std::copy(recorded.begin() + replay_pos, recorded.begin() + replay_pos + replayed, out);
+        replay_pos += replayed;
+        if (!recording && replay_pos == recorded.size()) {
+            vector<char>().swap(recorded);
+            replay_pos = 0;
+        }
+        stream.read(out + replayed, nbytes - replayed);
+        int64_t bytes_read = stream.gcount();
+        if (recording) {
+            recorded.insert(recorded.end(), out + replayed, out + replayed + bytes_read);
+            replay_pos = recorded.size();
+        }
+        return replayed + bytes_read;
+    }
 
    public:
     virtual ~ArrowInputStream() = default;
 
     ArrowInputStream(std::istream& stream) : stream(stream) {}
 
+    // starts recording the bytes that are read (from the current position, which must be the
+    // start of the stream)
+    void record() {
+        recording = true;
+    }
+
+    // stops recording and rewinds the stream to the start of the recording
+    void replay() {
+        recording = false;
+        replay_pos = 0;
+        pos = 0;
+    }
+
     virtual Status Close() final override {
         return Status::OK();
     };
@@ -63,8 +97,7 @@ class ArrowInputStream : public virtual ::arrow::io::InputStream {
     virtual arrow::Result<int64_t> Read(int64_t nbytes, void* out) final override
     {
         char* out_char = (char*)out;
-        stream.read(out_char, nbytes);
-        int64_t bytes_read = stream.gcount();
+        int64_t bytes_read = read_stream(nbytes, out_char);
         pos += bytes_read;
         return Result<int64_t>(bytes_read);
     }
@@ -84,14 +117,25 @@ class ArrowInputStream : public virtual ::arrow::io::InputStream {
         {
             return Result<std::shared_ptr<Buffer>>();
         }
-        stream.read((char*)(out->mutable_data()), nbytes);
-        int64_t bytes_read = stream.gcount();
+        int64_t bytes_read = read_stream(nbytes, (char*)(out->mutable_data()));
         pos += bytes_read;
         return Result<std::shared_ptr<Buffer>>(out);
     }
 };
 
-unique_ptr<Node> convert(std::istream& is, const ColumnFilter* column_filter);
+// expected_rows (if non-zero) is a hint for the number of rows in the stream
+unique_ptr<Node> convert(std::istream& is, const ColumnFilter* column_filter, size_t expected_rows);
+
+// reads a stream held in a buffer without copying it (the nodes may keep the buffer alive, as
+// values without nulls are used in place)
+unique_ptr<Node> convert(std::shared_ptr<Buffer> buffer, const ColumnFilter* column_filter,
+                         size_t expected_rows);
+
+// Reads the batches [begin_batch, end_batch) (end_batch < 0 for all remaining batches) of an Arrow
+// IPC file (e.g. Feather v2), converting the batches in parallel on the given number of threads (0
+// for one per core). Only the footer and the buffers of the requested batches are read.
+unique_ptr<Node> convert_file(const string& path, const ColumnFilter* column_filter,
+                              int64_t begin_batch, int64_t end_batch, size_t threads);
 
 }  // namespace arrow
 }  // namespace bamboo
@@ -91,14 +91,14 @@ struct AvroEnum final : public DynamicEnum {
     // at the beginning)
     const NodePtr schema;
 
-    unique_ptr<PrimitiveSimpleVector<string>> enum_values;
+    unique_ptr<BinaryVector> enum_values;
 
     AvroEnum(const NodePtr& schema) : schema(schema){};
 
     virtual PrimitiveVector& get_enums() override {
         // lazily compute the values of the enum
         if (!enum_values) {
-            enum_values = make_unique<PrimitiveSimpleVector<string>>();
+            enum_values = make_unique<BinaryVector>();
             for (size_t i = 0; i < schema->names(); i++) {
                 enum_values->add(schema->nameAt(i));
             }
@@ -0,0 +1,68 @@
+// Copyright (c) 2019 Michael Vilim
+//
+// This file is part of the bamboo library. It is currently hosted at
+// https://github.com/mvilim/bamboo
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace bamboo {
+namespace avro {
+
+using std::map;
+using std::string;
+using std::vector;
+
+enum class Codec { NULL_CODEC, DEFLATE, UNSUPPORTED };
+
+struct Block {
+    const uint8_t* data;
+    size_t size;
+    int64_t count;
+};
+
+// An index of the blocks of an Avro object container file held in memory. Unlike the avro
+// library's reader, this allows the blocks to be located up front (using the block sizes and sync
+// markers) and then decoded independently.
+class Container {
+    map<string, string> metadata;
+    vector<Block> blocks;
+    Codec codec;
+
+   public:
+    Container(const uint8_t* data, size_t size);
+
+    // the writer schema (as JSON)
+    const string& schema() const;
+
+    Codec get_codec() const {
+        return codec;
+    }
+
+    const vector<Block>& get_blocks() const {
+        return blocks;
+    }
+
+    // the decompressed contents of the block; output is used as the buffer for compressed blocks
+    // (and so must outlive the returned pointer)
+    const uint8_t* block_data(const Block& block, vector<uint8_t>& output, size_t& size) const;
+};
+
+}  // namespace avro
+}  // namespace bamboo
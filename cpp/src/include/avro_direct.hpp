@@ -25,76 +25,70 @@ namespace bamboo {
 namespace avro {
 namespace direct {
 
-// we could move all of this into the implementation
-class FieldIterator {
-    size_t pos = -1;
-    const CNode& datum;
-    size_t limit;
-
-   public:
-    FieldIterator(const CNode& datum) : datum(datum), limit(datum.leaves()){};
-
-    bool next() {
-        return ++pos < limit;
-    }
-
-    size_t key() {
-        return pos;
-    }
-
-    const CNode& value() {
-        return datum.leafAt(pos);
-    }
+enum class OpCode {
+    RECORD,
+    ARRAY,
+    NULLABLE,
+    NULL_VALUE,
+    BOOL,
+    INT,
+    LONG,
+    FLOAT,
+    DOUBLE,
+    STRING,
+    BYTES,
+    FIXED,
+    ENUM
 };
 
-class ListIterator {
-    Decoder& decoder;
-    const CNode& element_schema;
-    size_t remaining;
-    bool try_next;
-
-    // it's possible we could use this size information to reserve vector
-    // space (under some assumptions of nullity)
-   public:
-    ListIterator(Decoder& decoder, const CNode& datum)
-        : decoder(decoder), element_schema(datum.leafAt(0)), remaining(decoder.arrayStart()) {
-        try_next = remaining > 0;
-    };
-
-    bool next() {
-        if (remaining == 0 && try_next) {
-            remaining += decoder.arrayNext();
-        }
-
-        return remaining-- > 0;
-    };
-
-    const CNode& value() {
-        return element_schema;
-    }
+struct Op {
+    OpCode code;
+    // the node this instruction adds to (a nullable union shares its node with its non-null branch)
+    unique_ptr<Node>* target;
+    // one past the last instruction of this value (records, arrays and nullable unions are
+    // followed by the instructions of their children)
+    size_t end;
+    size_t null_branch;
+    size_t fixed_size;
+    shared_ptr<AvroEnum> enum_values;
 };
 
-class AvroDirectConverter final : public Converter<const CNode&, FieldIterator, ListIterator> {
-   private:
+// The reader schema compiled (once) into a flat, pre-order list of instructions, each bound to the
+// node it adds to, so that decoding a record is a single pass over the list without walking the
+// schema, resolving unions or dispatching on the avro type.
+class DecodePlan {
+    vector<Op> ops;
     Decoder& decoder;
+    DecodeScratch scratch;
 
-   public:
-    AvroDirectConverter(Decoder& decoder) : decoder(decoder){};
-
-    virtual ~AvroDirectConverter() final override = default;
+    void compile(const NodePtr& schema, unique_ptr<Node>& target);
 
-    virtual ObjType type(const CNode& datum) final override;
+    size_t add_op(OpCode code, unique_ptr<Node>& target);
 
-    virtual FieldIterator fields(const CNode& datum) final override;
+    PrimitiveNode& primitive(const Op& op);
 
-    virtual ListIterator get_list(const CNode& datum) final override;
+    void run(size_t begin, size_t end);
 
-    virtual void add_primitive(PrimitiveNode& v, const CNode& datum) final override;
+   public:
+    // builds the node tree for the schema under the target node
+    DecodePlan(const NodePtr& schema, unique_ptr<Node>& target, Decoder& decoder);
 
-    const CNode& read_union(const CNode& datum);
+    // decodes a single datum
+    void decode() {
+        run(0, ops.size());
+    }
 };
 
-unique_ptr<Node> convert(std::istream& is, const ColumnFilter* column_filter);
+// expected_rows (if non-zero) is a hint for the number of records in the file; with more than one
+// thread (or zero, for one per core) the blocks of the file are decoded in parallel, which first
+// reads the whole stream into memory (a single thread decodes the stream as it is read)
+unique_ptr<Node> convert(std::istream& is, const ColumnFilter* column_filter,
+                         size_t expected_rows, size_t threads);
+
+// converts a container file held in memory (which must outlive the call); uncompressed blocks are
+// decoded in place
+unique_ptr<Node> convert(const char* data, size_t size, const ColumnFilter* column_filter,
+                         size_t expected_rows, size_t threads);
 
 }  // namespace direct
 }  // namespace avro
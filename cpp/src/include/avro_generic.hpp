@@ -28,9 +28,6 @@ namespace generic {
 
 typedef std::pair<ValidSchema, GenericDatum> Pair;
 
-typedef KeyValueIterator<const string, const GenericDatum&> FieldIteratorType;
-typedef ValueIterator<const GenericDatum&> ListIteratorType;
-
 static ObjType type(const GenericDatum& datum) {
     if (datum.isUnion()) {
         const NodePtr& schema = datum.value<GenericUnion>().schema();
@@ -43,60 +40,56 @@ static ObjType type(const GenericDatum& datum) {
     return bamboo::avro::type(datum.type());
 }
 
-class FieldIterator final : public FieldIteratorType {
+class FieldIterator {
     size_t pos = -1;
     const GenericRecord& datum;
 
    public:
     FieldIterator(const GenericRecord& datum) : datum(datum){};
 
-    ~FieldIterator() final override = default;
-
-    virtual bool next() final override {
+    bool next() {
         return ++pos < datum.schema()->leaves();
     }
 
-    virtual const string key() final override {
+    const string& key() {
         return datum.schema()->nameAt(pos);
     }
 
-    virtual const GenericDatum& value() final override {
+    const GenericDatum& value() {
         return datum.fieldAt(pos);
     }
 };
 
-class ListIterator final : public ListIteratorType {
+class ListIterator {
     const vector<GenericDatum>& datum;
     size_t pos = -1;
 
-    // it's possible we could use this size information to reserve vector
-    // space (under some assumptions of nullity)
    public:
     ListIterator(const vector<GenericDatum>& datum) : datum(datum){};
 
-    ~ListIterator() final override = default;
+    size_t size_hint() {
+        return datum.size();
+    }
 
-    virtual bool next() final override {
+    bool next() {
         return ++pos < datum.size();
     };
 
-    virtual const GenericDatum& value() final override {
+    const GenericDatum& value() {
         return datum[pos];
     }
 };
 
 class AvroConverter final
-    : public virtual Converter<const GenericDatum&, FieldIterator, ListIterator> {
+    : public StaticConverter<AvroConverter, const GenericDatum&, FieldIterator, ListIterator> {
    public:
-    virtual ObjType type(const GenericDatum& datum) final override;
-
-    virtual FieldIterator fields(const GenericDatum& datum) final override;
+    ObjType type(const GenericDatum& datum);
 
-    virtual ListIterator get_list(const GenericDatum& datum) final override;
+    FieldIterator fields(const GenericDatum& datum);
 
-    virtual void add_primitive(PrimitiveNode& v, const GenericDatum& datum) final override;
+    ListIterator get_list(const GenericDatum& datum);
 
-    virtual ~AvroConverter() final override = default;
+    void add_primitive(PrimitiveNode& v, const GenericDatum& datum);
 };
 
 unique_ptr<Node> convert_with_schema(std::istream& is, const ValidSchema& schema);
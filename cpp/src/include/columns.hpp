@@ -17,15 +17,21 @@
 
 #pragma once
 
+#include <algorithm>
+#include <deque>
+#include <iterator>
 #include <map>
 #include <memory>
+#include <numeric>
 #include <string>
 #include <util.hpp>
+#include <utility>
 #include <vector>
 #include <iostream>
 
 namespace bamboo {
 
+using std::deque;
 using std::map;
 using std::reference_wrapper;
 using std::shared_ptr;
@@ -50,9 +56,18 @@ enum class PrimitiveType {
     FLOAT64,
     STRING,
     BYTE_ARRAY,
-    ENUM
+    FIXED_BYTE_ARRAY,
+    ENUM,
+    DATE32,
+    TIME32,
+    TIME64,
+    TIMESTAMP,
+    DECIMAL128
 };
 
+// the unit of temporal values (dates always count days)
+enum class TemporalUnit { DAY, SECOND, MILLI, MICRO, NANO };
+
 template <class T> struct PrimitiveEnum;
 template <PrimitiveType T> struct PrimitiveTyper {
     static constexpr PrimitiveType primitive_enum = T;
@@ -62,6 +77,15 @@ template <class T> constexpr PrimitiveType primitive_enum(const T& t) {
     return PrimitiveEnum<T>::primitive_enum;
 }
 
+// reserves room for (at least) additional more elements without giving up geometric growth, so that
+// it can be called with many small hints
+template <class T> void reserve_more(vector<T>& vec, size_t additional) {
+    size_t required = vec.size() + additional;
+    if (required > vec.capacity()) {
+        vec.reserve(std::max(required, vec.capacity() * 2));
+    }
+}
+
 template <class T> struct VectorType { typedef T vector_type; };
 template <PrimitiveType T> struct VectorTyper;
 
@@ -78,18 +102,41 @@ struct PrimitiveVector {
 
     PrimitiveVector(PrimitiveType type) : type(type) {}
 
-    PrimitiveType get_type() {
+    PrimitiveType get_type() const {
         return type;
     }
 
-    template <PrimitiveType T> auto& get_values() {
+    // a hint that (about) additional more values will be added
+    virtual void reserve(size_t additional) {}
+
+    // moves the values of other (which must have the same type) to the end of this vector
+    virtual void concat(PrimitiveVector& other) {
+        throw std::logic_error("Concatenation not implemented for this type");
+    }
+
+    // drops the values after the first size
+    virtual void truncate(size_t size) {
+        throw std::logic_error("Truncation not implemented for this type");
+    }
+
+    // a copy of this vector (values borrowed from an external buffer stay borrowed, sharing the
+    // buffer's owner)
+    virtual unique_ptr<PrimitiveVector> copy() const {
+        return make_unique<PrimitiveVector>(type);
+    }
+
+    template <PrimitiveType T> auto& get_typed_vector() {
         if (type == T) {
-            return static_cast<typename VectorTyper<T>::vector_type&>(*this).get_vector();
+            return static_cast<typename VectorTyper<T>::vector_type&>(*this);
         } else {
             throw std::logic_error("Attempted to access values with wrong type");
         }
     }
 
+    template <PrimitiveType T> auto& get_values() {
+        return get_typed_vector<T>().get_vector();
+    }
+
     const DynamicEnumVector& get_enums();
 
     template <PrimitiveType T> static auto create() {
@@ -111,6 +158,12 @@ struct DynamicEnum {
         return (source() == other.source()) && source() != NULL;
     };
 
+    // whether the values of this enum start with all the values of other (so that indices into
+    // other are also valid indices into this enum), e.g. after a delta dictionary
+    virtual bool extends(DynamicEnum& other) {
+        return same_source(other);
+    }
+
     virtual ~DynamicEnum() = default;
 };
 
@@ -122,27 +175,477 @@ struct DynamicEnumValue {
 };
 
 struct DynamicEnumVector {
-    vector<std::size_t> index;
+    // the indices into the enum values (an integer vector of any width)
+    unique_ptr<PrimitiveVector> index;
     shared_ptr<DynamicEnum> values;
 };
 
+// A column that grows in fixed size chunks, so that appending values never copies (or briefly
+// requires double the memory of) the values that have already been written. Small columns grow
+// geometrically (as a plain vector would) until they fill a single chunk. The chunks are
+// consolidated into one contiguous vector the first time the values are accessed as a whole.
+template <class T> class ChunkedVector {
+    // large enough that the allocator serves (and releases) each chunk as its own mapping, so that
+    // consolidation can return the memory of each chunk as soon as it has been copied
+    static constexpr size_t chunk_bytes = 1 << 20;
+    static constexpr size_t chunk_size = sizeof(T) < chunk_bytes ? chunk_bytes / sizeof(T) : 1;
+
+    vector<vector<T>> chunks;
+    vector<T> tail;
+    size_t chunked_size = 0;
+
+    void make_room(size_t n) {
+        size_t required = tail.size() + n;
+        if (required <= tail.capacity()) {
+            return;
+        }
+        if (required <= chunk_size || tail.empty()) {
+            tail.reserve(std::max(required, std::min(tail.capacity() * 2, chunk_size)));
+        } else {
+            chunked_size += tail.size();
+            chunks.push_back(std::move(tail));
+            tail = vector<T>();
+            tail.reserve(std::max(n, chunk_size));
+        }
+    }
+
+   public:
+    // a hint for the number of values that will be added, which never reserves more than a chunk
+    // ahead (so that a large hint cannot defeat the chunking)
+    void reserve(size_t additional) {
+        make_room(std::min(additional, chunk_size));
+    }
+
+    void push_back(const T& t) {
+        make_room(1);
+        tail.push_back(t);
+    }
+
+    void append(const T* values, size_t n) {
+        make_room(n);
+        tail.insert(tail.end(), values, values + n);
+    }
+
+    // moves the values of other (in whole chunks) to the end of this vector
+    void concat(ChunkedVector&& other) {
+        if (other.size() == 0) {
+            return;
+        }
+        if (!tail.empty()) {
+            chunked_size += tail.size();
+            chunks.push_back(std::move(tail));
+        }
+        for (vector<T>& chunk : other.chunks) {
+            chunked_size += chunk.size();
+            chunks.push_back(std::move(chunk));
+        }
+        tail = std::move(other.tail);
+        other.chunks.clear();
+        other.tail = vector<T>();
+        other.chunked_size = 0;
+    }
+
+    // returns n contiguous (value initialized) elements to be written by the caller
+    T* extend(size_t n) {
+        make_room(n);
+        size_t start = tail.size();
+        tail.resize(start + n);
+        return tail.data() + start;
+    }
+
+    size_t size() const {
+        return chunked_size + tail.size();
+    }
+
+    const T& back() const {
+        return tail.empty() ? chunks.back().back() : tail.back();
+    }
+
+    // drops the values after the first size
+    void truncate(size_t size) {
+        while (chunked_size > size) {
+            tail = std::move(chunks.back());
+            chunks.pop_back();
+            chunked_size -= tail.size();
+        }
+        if (size - chunked_size < tail.size()) {
+            tail.resize(size - chunked_size);
+        }
+    }
+
+    vector<T>& consolidate() {
+        if (!chunks.empty()) {
+            vector<T> values;
+            values.reserve(size());
+            for (vector<T>& chunk : chunks) {
+                values.insert(values.end(), std::make_move_iterator(chunk.begin()),
+                              std::make_move_iterator(chunk.end()));
+                vector<T>().swap(chunk);
+            }
+            values.insert(values.end(), std::make_move_iterator(tail.begin()),
+                          std::make_move_iterator(tail.end()));
+            chunks.clear();
+            chunked_size = 0;
+            tail = std::move(values);
+        }
+        return tail;
+    }
+};
+
+template <class T> constexpr size_t ChunkedVector<T>::chunk_bytes;
+template <class T> constexpr size_t ChunkedVector<T>::chunk_size;
+
 template <class T> class PrimitiveSimpleVector : public PrimitiveVector {
    private:
-    vector<T> vec;
+    // a run of values in an external buffer (e.g. an Arrow array), which owner keeps alive
+    struct Borrowed {
+        const T* data;
+        size_t size;
+        shared_ptr<const void> owner;
+    };
+
+    ChunkedVector<T> vec;
+    // values used in place (e.g. one run per Arrow record batch); there are only borrowed values
+    // while vec is empty, and they are copied into vec if the vector is modified or if there is
+    // more than one run when the values are accessed
+    vector<Borrowed> borrowed;
+    size_t borrowed_size = 0;
+    // the owners of runs that have since been copied into vec, which are kept for as long as this
+    // vector lives because views of the runs (e.g. from runs()) may still be in use
+    vector<shared_ptr<const void>> retired;
+
+    void own() {
+        if (!borrowed.empty()) {
+            vector<Borrowed> runs = std::move(borrowed);
+            borrowed.clear();
+            borrowed_size = 0;
+            vec.reserve(std::accumulate(
+                runs.begin(), runs.end(), size_t(0),
+                [](size_t n, const Borrowed& run) { return n + run.size; }));
+            for (Borrowed& run : runs) {
+                vec.append(run.data, run.size);
+                retired.push_back(std::move(run.owner));
+            }
+        }
+    }
 
    public:
+    typedef T value_type;
+
     virtual ~PrimitiveSimpleVector() = default;
 
     PrimitiveSimpleVector() : PrimitiveVector(PrimitiveEnum<T>::primitive_enum) {}
 
     PrimitiveSimpleVector(PrimitiveType type) : PrimitiveVector(type) {}
 
-    void add(T t) {
+    void add(const T& t) {
+        own();
         vec.push_back(t);
     }
 
+    // returns n (value initialized) values to be written by the caller
+    T* extend(size_t n) {
+        own();
+        return vec.extend(n);
+    }
+
+    // adds the n values at data (which must stay valid as long as owner is held), without copying
+    // them unless this vector already holds values of its own
+    void borrow(const T* data, size_t n, shared_ptr<const void> owner) {
+        if (n == 0) {
+            return;
+        }
+        if (vec.size() != 0) {
+            vec.append(data, n);
+        } else {
+            borrowed.push_back({data, n, std::move(owner)});
+            borrowed_size += n;
+        }
+    }
+
+    virtual void reserve(size_t additional) override {
+        if (borrowed.empty()) {
+            vec.reserve(additional);
+        }
+    }
+
+    virtual void concat(PrimitiveVector& other) override {
+        PrimitiveSimpleVector& source = static_cast<PrimitiveSimpleVector&>(other);
+        retired.insert(retired.end(), std::make_move_iterator(source.retired.begin()),
+                       std::make_move_iterator(source.retired.end()));
+        source.retired.clear();
+        if (!source.borrowed.empty()) {
+            for (Borrowed& run : source.borrowed) {
+                borrow(run.data, run.size, std::move(run.owner));
+            }
+            source.borrowed.clear();
+            source.borrowed_size = 0;
+        } else {
+            own();
+            vec.concat(std::move(source.vec));
+        }
+    }
+
+    virtual void truncate(size_t size) override {
+        own();
+        vec.truncate(size);
+    }
+
+    virtual unique_ptr<PrimitiveVector> copy() const override {
+        return make_unique<PrimitiveSimpleVector>(*this);
+    }
+
+    size_t size() const {
+        return borrowed_size + vec.size();
+    }
+
+    // the values as contiguous runs, without copying them: the borrowed runs (e.g. one for each
+    // Arrow record batch) or the values this vector holds itself
+    vector<std::pair<const T*, size_t>> runs() {
+        vector<std::pair<const T*, size_t>> result;
+        for (const Borrowed& run : borrowed) {
+            result.emplace_back(run.data, run.size);
+        }
+        if (result.empty()) {
+            vector<T>& values = vec.consolidate();
+            result.emplace_back(values.data(), values.size());
+        }
+        return result;
+    }
+
+    // the values, without copying them if they are a single borrowed run
+    const T* data() {
+        if (borrowed.size() == 1) {
+            return borrowed.front().data;
+        }
+        own();
+        return vec.consolidate().data();
+    }
+
     vector<T>& get_vector() {
-        return vec;
+        own();
+        return vec.consolidate();
+    }
+};
+
+// Integer temporal values (counted from the epoch, or from midnight for times of day) along with
+// their unit and (for timestamps) time zone, so that they can be viewed as numpy datetimes
+template <class T> class TemporalVector : public PrimitiveSimpleVector<T> {
+   private:
+    TemporalUnit unit;
+    string timezone;
+
+   public:
+    virtual ~TemporalVector() = default;
+
+    TemporalVector(PrimitiveType type)
+        : PrimitiveSimpleVector<T>(type),
+          unit(type == PrimitiveType::DATE32 ? TemporalUnit::DAY : TemporalUnit::SECOND) {}
+
+    void set_unit(TemporalUnit unit, const string& timezone = "") {
+        this->unit = unit;
+        this->timezone = timezone;
+    }
+
+    TemporalUnit get_unit() const {
+        return unit;
+    }
+
+    const string& get_timezone() const {
+        return timezone;
+    }
+
+    virtual void concat(PrimitiveVector& other) override {
+        TemporalVector& source = static_cast<TemporalVector&>(other);
+        if (source.unit != unit || source.timezone != timezone) {
+            throw std::invalid_argument("Mismatched temporal units");
+        }
+        PrimitiveSimpleVector<T>::concat(other);
+    }
+
+    virtual unique_ptr<PrimitiveVector> copy() const override {
+        return make_unique<TemporalVector>(*this);
+    }
+};
+
+// Variable length values stored back to back in a single byte buffer and delimited by an offsets
+// array with one more entry than there are values (the same layout as Arrow's large string arrays)
+class BinaryVector : public PrimitiveVector {
+   private:
+    ChunkedVector<int64_t> offsets;
+    ChunkedVector<char> data;
+
+   public:
+    virtual ~BinaryVector() = default;
+
+    BinaryVector() : BinaryVector(PrimitiveType::STRING) {}
+
+    BinaryVector(PrimitiveType type) : PrimitiveVector(type) {
+        offsets.push_back(0);
+    }
+
+    void add(const char* value, size_t length) {
+        data.append(value, length);
+        offsets.push_back(data.size());
+    }
+
+    void add(const string& value) {
+        add(value.data(), value.size());
+    }
+
+    void add(const vector<uint8_t>& value) {
+        add(reinterpret_cast<const char*>(value.data()), value.size());
+    }
+
+    // returns space for a value of the given length, to be written by the caller
+    char* add(size_t length) {
+        char* value = data.extend(length);
+        offsets.push_back(data.size());
+        return value;
+    }
+
+    // adds n values delimited by the n + 1 (Arrow style) value_offsets into values
+    template <class O> void append(const O* value_offsets, size_t n, const char* values) {
+        int64_t base = static_cast<int64_t>(data.size()) - value_offsets[0];
+        int64_t* appended = offsets.extend(n);
+        for (size_t i = 0; i < n; i++) {
+            appended[i] = value_offsets[i + 1] + base;
+        }
+        data.append(values + value_offsets[0], value_offsets[n] - value_offsets[0]);
+    }
+
+    virtual void reserve(size_t additional) override {
+        offsets.reserve(additional);
+    }
+
+    // a hint for the total length of the values that will be added
+    void reserve_bytes(size_t additional) {
+        data.reserve(additional);
+    }
+
+    virtual void concat(PrimitiveVector& other) override;
+
+    virtual void truncate(size_t size) override {
+        offsets.truncate(size + 1);
+        data.truncate(offsets.back());
+    }
+
+    virtual unique_ptr<PrimitiveVector> copy() const override {
+        return make_unique<BinaryVector>(*this);
+    }
+
+    size_t size() const {
+        return offsets.size() - 1;
+    }
+
+    const vector<int64_t>& get_offsets() {
+        return offsets.consolidate();
+    }
+
+    const vector<char>& get_data() {
+        return data.consolidate();
+    }
+};
+
+// Fixed width binary values (e.g. Avro fixed) stored back to back in a single byte buffer
+class FixedBinaryVector : public PrimitiveVector {
+   private:
+    size_t width;
+    size_t count = 0;
+    ChunkedVector<uint8_t> data;
+
+   public:
+    virtual ~FixedBinaryVector() = default;
+
+    FixedBinaryVector(PrimitiveType type) : FixedBinaryVector(type, 0) {}
+
+    FixedBinaryVector(PrimitiveType type, size_t width) : PrimitiveVector(type), width(width) {}
+
+    void add(const uint8_t* value) {
+        data.append(value, width);
+        count++;
+    }
+
+    void add(const vector<uint8_t>& value) {
+        if (value.size() != width) {
+            throw std::invalid_argument("Mismatched fixed binary width");
+        }
+        add(value.data());
+    }
+
+    // adds the n values stored back to back at values
+    void append(const uint8_t* values, size_t n) {
+        data.append(values, n * width);
+        count += n;
+    }
+
+    virtual void reserve(size_t additional) override {
+        data.reserve(additional * width);
+    }
+
+    virtual void concat(PrimitiveVector& other) override;
+
+    virtual void truncate(size_t size) override {
+        if (size < count) {
+            data.truncate(size * width);
+            count = size;
+        }
+    }
+
+    virtual unique_ptr<PrimitiveVector> copy() const override {
+        return make_unique<FixedBinaryVector>(*this);
+    }
+
+    size_t get_width() const {
+        return width;
+    }
+
+    size_t size() const {
+        return count;
+    }
+
+    const vector<uint8_t>& get_data() {
+        return data.consolidate();
+    }
+};
+
+// 128 bit decimals, stored as their (little endian, two's complement) unscaled values
+class DecimalVector : public FixedBinaryVector {
+   private:
+    int32_t precision = 0;
+    int32_t scale = 0;
+
+   public:
+    static constexpr size_t byte_width = 16;
+
+    virtual ~DecimalVector() = default;
+
+    DecimalVector(PrimitiveType type) : FixedBinaryVector(type, byte_width) {}
+
+    void set_scale(int32_t precision, int32_t scale) {
+        this->precision = precision;
+        this->scale = scale;
+    }
+
+    int32_t get_precision() const {
+        return precision;
+    }
+
+    int32_t get_scale() const {
+        return scale;
+    }
+
+    virtual void concat(PrimitiveVector& other) override {
+        if (static_cast<DecimalVector&>(other).scale != scale) {
+            throw std::invalid_argument("Mismatched decimal scales");
+        }
+        // the precision only bounds the values, so the wider one covers both
+        precision = std::max(precision, static_cast<DecimalVector&>(other).precision);
+        FixedBinaryVector::concat(other);
+    }
+
+    virtual unique_ptr<PrimitiveVector> copy() const override {
+        return make_unique<DecimalVector>(*this);
     }
 };
 
@@ -150,17 +653,38 @@ class PrimitiveEnumVector : public PrimitiveVector {
    private:
     DynamicEnumVector enums;
 
+    void append_remapped(PrimitiveVector& source, const vector<size_t>& remap);
+
    public:
     virtual ~PrimitiveEnumVector() = default;
 
     // we don't specify the type because it will always be passed in by the templatized create
-    PrimitiveEnumVector(PrimitiveType type) : PrimitiveVector(type) {}
+    PrimitiveEnumVector(PrimitiveType type) : PrimitiveVector(type) {
+        enums.index = make_unique<PrimitiveSimpleVector<uint64_t>>(PrimitiveType::UINT64);
+    }
 
     PrimitiveEnumVector(DynamicEnumVector&& enums)
-        : PrimitiveVector(PrimitiveType::ENUM), enums(enums) {}
+        : PrimitiveVector(PrimitiveType::ENUM), enums(std::move(enums)) {}
 
     void add(const DynamicEnumValue& t);
 
+    // adds a value of the enum this vector already holds (to the uint64 index it was created with)
+    void add_index(size_t index) {
+        static_cast<PrimitiveSimpleVector<uint64_t>&>(*enums.index).add(index);
+    }
+
+    virtual void reserve(size_t additional) override {
+        enums.index->reserve(additional);
+    }
+
+    virtual void concat(PrimitiveVector& other) override;
+
+    virtual void truncate(size_t size) override {
+        enums.index->truncate(size);
+    }
+
+    virtual unique_ptr<PrimitiveVector> copy() const override;
+
     const DynamicEnumVector& get_enums_vector() {
         return enums;
     }
@@ -199,14 +723,35 @@ template <> struct VectorTyper<PrimitiveType::UINT64> : PrimitiveVectorType<uint
 template <> struct VectorTyper<PrimitiveType::FLOAT16> : PrimitiveVectorType<uint16_t> {};
 template <> struct VectorTyper<PrimitiveType::FLOAT32> : PrimitiveVectorType<float> {};
 template <> struct VectorTyper<PrimitiveType::FLOAT64> : PrimitiveVectorType<double> {};
-template <> struct VectorTyper<PrimitiveType::STRING> : PrimitiveVectorType<string> {};
+template <> struct VectorTyper<PrimitiveType::STRING> : VectorType<BinaryVector> {};
 template <> struct VectorTyper<PrimitiveType::BOOL> : PrimitiveVectorType<uint8_t> {};
 template <> struct VectorTyper<PrimitiveType::ENUM> : VectorType<PrimitiveEnumVector> {};
-template <> struct VectorTyper<PrimitiveType::BYTE_ARRAY> : PrimitiveVectorType<vector<uint8_t>> {};
-
+template <> struct VectorTyper<PrimitiveType::BYTE_ARRAY> : VectorType<BinaryVector> {};
+template <>
+struct VectorTyper<PrimitiveType::FIXED_BYTE_ARRAY> : VectorType<FixedBinaryVector> {};
+template <> struct VectorTyper<PrimitiveType::DATE32> : VectorType<TemporalVector<int32_t>> {};
+template <> struct VectorTyper<PrimitiveType::TIME32> : VectorType<TemporalVector<int32_t>> {};
+template <> struct VectorTyper<PrimitiveType::TIME64> : VectorType<TemporalVector<int64_t>> {};
+template <> struct VectorTyper<PrimitiveType::TIMESTAMP> : VectorType<TemporalVector<int64_t>> {};
+template <> struct VectorTyper<PrimitiveType::DECIMAL128> : VectorType<DecimalVector> {};
+
+// Nulls start out recorded as a list of null indices (cheap when nulls are rare). Once nulls are
+// dense enough that the list would be larger than a validity bitmap, the indicator switches to a
+// packed bitmap (one bit per value, set for values that are not null, in Arrow's LSB bit order).
 class NullIndicator {
+    // the minimum number of nulls before we consider switching to the bitmap (this avoids
+    // switching on the first few values of a column, where the density is meaningless)
+    static constexpr size_t min_bitmap_nulls = 64;
+
     size_t size = 0;
+    size_t null_count = 0;
+    // the size the indicator is expected to (at least) grow to
+    size_t expected_size = 0;
     vector<size_t> index;
+    vector<uint8_t> bitmap;
+    bool use_bitmap = false;
+
+    void switch_to_bitmap();
 
    public:
     virtual ~NullIndicator() = default;
@@ -215,9 +760,26 @@ class NullIndicator {
 
     NullIndicator(NullIndicator&& source) {
         index = std::move(source.index);
+        bitmap = std::move(source.bitmap);
+        use_bitmap = source.use_bitmap;
         size = source.size;
+        null_count = source.null_count;
+        expected_size = source.expected_size;
     }
 
+    NullIndicator(const NullIndicator& source) = default;
+
+    NullIndicator& operator=(NullIndicator&& source) = default;
+
+    NullIndicator& operator=(const NullIndicator& source) = default;
+
+    // appends the entries of other to this indicator
+    void append(const NullIndicator& other);
+
+    // appends length entries from an Arrow style validity bitmap (starting at bit offset) with the
+    // given number of nulls; a missing bitmap means that none of the entries are null
+    void append_validity(const uint8_t* validity, size_t offset, size_t length, size_t nulls);
+
     void add_null();
 
     void add_not_null();
@@ -226,9 +788,30 @@ class NullIndicator {
         return size;
     }
 
-    const vector<size_t>& get_indices() {
-        return index;
+    size_t get_null_count() {
+        return null_count;
     }
+
+    void reserve(size_t additional);
+
+    // drops the entries after the first length
+    void truncate(size_t length);
+
+    size_t get_expected_size() {
+        return expected_size;
+    }
+
+    bool is_bitmap() {
+        return use_bitmap;
+    }
+
+    bool is_null(size_t i) const;
+
+    // only available while the nulls are stored as indices (i.e. !is_bitmap())
+    const vector<size_t>& get_indices();
+
+    // only available once the nulls are stored as a bitmap (i.e. is_bitmap())
+    const vector<uint8_t>& get_bitmap();
 };
 
 enum class ObjType { INCOMPLETE, RECORD, LIST, PRIMITIVE };
@@ -267,6 +850,12 @@ class Node : public NullIndicator {
 
     Node(ObjType type, NullIndicator&& null_indicator)
         : NullIndicator(std::move(null_indicator)), type(type){};
+
+    // a hint that (about) additional more values will be added to this node (and so to each of
+    // its record fields); nodes that have not been typed yet apply it once they are
+    virtual void reserve(size_t additional) {
+        NullIndicator::reserve(additional);
+    }
 };
 
 class IncompleteNode : public Node, Visitable<IncompleteNode> {
@@ -281,6 +870,14 @@ class IncompleteNode : public Node, Visitable<IncompleteNode> {
 class PrimitiveNode : public Node, Visitable<PrimitiveNode> {
     unique_ptr<PrimitiveVector> values = make_unique<PrimitiveVector>();
 
+    // applies any reservation made before the values were typed
+    void set_values(unique_ptr<PrimitiveVector>&& typed_values) {
+        values = std::move(typed_values);
+        if (get_expected_size() > get_size()) {
+            values->reserve(get_expected_size() - get_size());
+        }
+    }
+
    public:
     virtual ~PrimitiveNode() = default;
 
@@ -288,21 +885,31 @@ class PrimitiveNode : public Node, Visitable<PrimitiveNode> {
 
     PrimitiveNode(Node&& source) : Node(ObjType::PRIMITIVE, std::move(source)){};
 
-    PrimitiveType get_type();
+    PrimitiveType get_type() const;
 
     unique_ptr<PrimitiveVector>& get_vector();
 
+    const unique_ptr<PrimitiveVector>& get_vector() const;
+
     // we should put the init piece inside the vector type (something where you pass it the
     // primitive enum and get back a vector of the correct type with the type set)
     template <class T> void init() {
-        values = PrimitiveVector::create<PrimitiveEnum<T>::primitive_enum>();
+        set_values(PrimitiveVector::create<PrimitiveEnum<T>::primitive_enum>());
     }
 
     template <PrimitiveType T> void init_type() {
-        values = PrimitiveVector::create<T>();
+        set_values(PrimitiveVector::create<T>());
     }
 
-    template <class T> void add(T t) {
+    virtual void reserve(size_t additional) override {
+        Node::reserve(additional);
+        values->reserve(additional);
+    }
+
+    // moves the values of other to the end of this node's values
+    void concat_values(PrimitiveNode& other);
+
+    template <class T> void add(const T& t) {
         if (values->type == PrimitiveType::EMPTY) {
             init<T>();
         }
@@ -318,24 +925,51 @@ class PrimitiveNode : public Node, Visitable<PrimitiveNode> {
         }
     }
 
-    template <PrimitiveType PT, class T> void add_by_type(T t) {
+    template <PrimitiveType PT, class T> void add_by_type(const T& t) {
         if (values->type == PrimitiveType::EMPTY) {
             init_type<PT>();
         }
         static_cast<typename VectorTyper<PT>::vector_type&>(*values).add(t);
     }
 
-    template <class T> void add_unsafe(T t) {
+    template <class T> void add_unsafe(const T& t) {
         static_cast<typename VectorTyper<PrimitiveEnum<T>::primitive_enum>::vector_type&>(*values)
             .add(t);
     }
 
-    // it would be better to adapt the add method to be able to efficiently move strings (a simple tested showed a performance impact)
-    string& add_string() {
-        vector<string>& vec = static_cast<typename VectorTyper<PrimitiveType::STRING>::vector_type&>(*values)
-            .get_vector();
-        vec.emplace_back();
-        return vec.back();
+    void add_string(const char* value, size_t length) {
+        if (values->type == PrimitiveType::EMPTY) {
+            init_type<PrimitiveType::STRING>();
+        }
+        values->get_typed_vector<PrimitiveType::STRING>().add(value, length);
+    }
+
+    // returns space for a string of the given length (which the caller must fill), avoiding an
+    // intermediate string when the source can be read directly into the column
+    char* add_string(size_t length) {
+        return static_cast<typename VectorTyper<PrimitiveType::STRING>::vector_type&>(*values)
+            .add(length);
+    }
+
+    // as add_string, but for byte arrays
+    char* add_bytes(size_t length) {
+        return static_cast<typename VectorTyper<PrimitiveType::BYTE_ARRAY>::vector_type&>(*values)
+            .add(length);
+    }
+
+    void init_fixed(size_t width) {
+        set_values(make_unique<FixedBinaryVector>(PrimitiveType::FIXED_BYTE_ARRAY, width));
+    }
+
+    void add_fixed(const uint8_t* value, size_t width) {
+        if (values->type == PrimitiveType::EMPTY) {
+            init_fixed(width);
+        }
+        FixedBinaryVector& fixed = values->get_typed_vector<PrimitiveType::FIXED_BYTE_ARRAY>();
+        if (fixed.get_width() != width) {
+            throw std::invalid_argument("Mismatched fixed binary width");
+        }
+        fixed.add(value);
     }
 
     template <PrimitiveType T> auto& get_values() {
@@ -360,17 +994,39 @@ class ListNode : public Node, Visitable<ListNode> {
 
     unique_ptr<Node>& get_list();
 
+    const unique_ptr<Node>& get_list() const;
+
     void add_list(size_t length);
 
+    // moves the list lengths of other to the end of this node's
+    void concat_index(ListNode& other);
+
+    // drops the list lengths after the first size, returning the total length of the dropped lists
+    size_t truncate_index(size_t size);
+
+    virtual void reserve(size_t additional) override;
+
     const vector<size_t>& get_index();
+
+    const vector<size_t>& get_index() const;
 };
 
 class RecordNode : public Node, Visitable<ListNode> {
-    map<string, unique_ptr<Node>> fields_map;
-    vector<reference_wrapper<unique_ptr<Node>>> field_vec;
+    // fields are stored by slot (in the order they were first seen); a deque keeps references to
+    // the slots valid as new fields are added
+    deque<unique_ptr<Node>> slots;
     vector<string> field_names;
+    // open addressing (linear probing) table of slot + 1, with 0 marking an empty bucket
+    vector<size_t> buckets;
+    // the slot after the most recently looked up field -- records of the same shape usually repeat
+    // their field order, so this is checked before hashing
+    size_t next_slot = 0;
+
+    bool slot_matches(size_t slot, const char* name, size_t length) const;
+
+    void insert_bucket(size_t slot);
 
-    void add_field(const string& name);
+    size_t add_field(const char* name, size_t length);
 
    public:
     RecordNode() : Node(ObjType::RECORD){};
@@ -381,13 +1037,38 @@ class RecordNode : public Node, Visitable<ListNode> {
 
     virtual ~RecordNode() = default;
 
+    // returns the slot of the named field, adding the field if it has not been seen
+    size_t get_slot(const char* name, size_t length);
+
+    unique_ptr<Node>& get_field(const char* name, size_t length);
+
     unique_ptr<Node>& get_field(const string& name);
 
     unique_ptr<Node>& get_field(size_t index);
 
-    const vector<string> get_fields();
+    const unique_ptr<Node>& get_field(size_t index) const;
+
+    size_t get_field_count() const;
+
+    const vector<string>& get_fields() const;
+
+    virtual void reserve(size_t additional) override;
 };
 
+// Appends the entries of source to target, moving (rather than copying) buffers where possible and
+// leaving source empty. Either side may be incomplete (e.g. if all of its values were null), and
+// record fields missing from either side are filled with nulls. Enums are only combined if they
+// share a source.
+void concat(unique_ptr<Node>& target, Node& source);
+
+// Drops the entries of node (and so of its children) after the first size, e.g. to replace the
+// value of a repeated JSON member
+void truncate(Node& node, size_t size);
+
+// A deep copy of node, e.g. to concatenate nodes whose values may already be viewed elsewhere
+// (values borrowed from external buffers stay borrowed, sharing the buffers' owners)
+unique_ptr<Node> copy_node(const Node& node);
+
 class NodeBuilder : public Visitor<PrimitiveNode>,
                     public Visitor<IncompleteNode>,
                     public Visitor<ListNode>,
@@ -424,26 +1105,22 @@ struct ColumnFilter {
         }
         return has_includes;
     }
-};
-
-template <class T> class ValueIterator {
-   public:
-    virtual bool next() = 0;
-
-    virtual T value() = 0;
-
-    virtual ~ValueIterator() = default;
-};
-
-template <class K, class V> class KeyValueIterator {
-   public:
-    virtual bool next() = 0;
-
-    virtual K key() = 0;
 
-    virtual V value() = 0;
+    // the filter for the named field of a (possibly null) filter, or null if it has none
+    static const ColumnFilter* child(const ColumnFilter* column_filter, const string& name) {
+        if (column_filter && column_filter->field_filters.count(name)) {
+            return column_filter->field_filters.at(name).get();
+        }
+        return nullptr;
+    }
 
-    virtual ~KeyValueIterator() = default;
+    // whether values under a (possibly null) filter are included, given whether they would be
+    // included implicitly (i.e. without an explicit include or exclude)
+    static bool included(const ColumnFilter* column_filter, bool implicit_include) {
+        bool explicit_include = column_filter && column_filter->explicitly_include;
+        bool explicit_exclude = column_filter && column_filter->explicitly_exclude;
+        return explicit_include || (implicit_include && !explicit_exclude);
+    }
 };
 
 static void init(unique_ptr<Node>& node, ObjType type) {
@@ -462,19 +1139,14 @@ static void init(unique_ptr<Node>& node, ObjType type) {
     }
 }
 
-template <class T, class F, class L> struct Converter {
-    virtual ObjType type(T datum) = 0;
-
-    virtual F fields(T datum) = 0;
-
-    virtual L get_list(T datum) = 0;
-
-    virtual void add_primitive(PrimitiveNode& v, T datum) = 0;
-
-    virtual ~Converter() = default;
-
+// the recursive conversion, statically dispatched to the format converter D (which must provide
+// type, fields, get_list and add_primitive for datum type T, returning field iterators F and list
+// iterators L, which also provide a size_hint) so that the whole recursion can be inlined for each
+// format
+template <class D, class T, class F, class L> struct StaticConverter {
     void convert(unique_ptr<Node>& node, T t) {
-        ObjType obj_type = type(t);
+        D& converter = static_cast<D&>(*this);
+        ObjType obj_type = converter.type(t);
         if (node->type == ObjType::INCOMPLETE) {
             init(node, obj_type);
         }
@@ -487,7 +1159,7 @@ template <class T, class F, class L> struct Converter {
             case ObjType::RECORD: {
                 RecordNode& record_node = *static_cast<RecordNode*>(node.get());
 
-                auto f = fields(t);
+                F f = converter.fields(t);
                 while (f.next()) {
                     unique_ptr<Node>& field_node = record_node.get_field(f.key());
                     convert(field_node, f.value());
@@ -500,7 +1172,11 @@ template <class T, class F, class L> struct Converter {
 
                 unique_ptr<Node>& sub_node = list_node.get_list();
                 size_t counter = 0;
-                auto l = get_list(t);
+                L l = converter.get_list(t);
+                size_t hint = l.size_hint();
+                if (hint > 1) {
+                    sub_node->reserve(hint);
+                }
                 while (l.next()) {
                     convert(sub_node, l.value());
                     counter++;
@@ -511,7 +1187,7 @@ template <class T, class F, class L> struct Converter {
             }
             case ObjType::PRIMITIVE: {
                 PrimitiveNode& primitive_node = *static_cast<PrimitiveNode*>(node.get());
-                add_primitive(primitive_node, t);
+                converter.add_primitive(primitive_node, t);
                 primitive_node.add_not_null();
                 break;
             }
@@ -522,4 +1198,18 @@ template <class T, class F, class L> struct Converter {
     };
 };
 
+// virtual interface to the conversion, for converters that do not need static dispatch
+template <class T, class F, class L>
+struct Converter : StaticConverter<Converter<T, F, L>, T, F, L> {
+    virtual ObjType type(T datum) = 0;
+
+    virtual F fields(T datum) = 0;
+
+    virtual L get_list(T datum) = 0;
+
+    virtual void add_primitive(PrimitiveNode& v, T datum) = 0;
+
+    virtual ~Converter() = default;
+};
+
 }  // namespace bamboo
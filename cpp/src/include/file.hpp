@@ -0,0 +1,82 @@
+// Copyright (c) 2019 Michael Vilim
+//
+// This file is part of the bamboo library. It is currently hosted at
+// https://github.com/mvilim/bamboo
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+namespace bamboo {
+
+using std::string;
+using std::unique_ptr;
+
+// A file descriptor opened for reading (and closed when destroyed)
+class InputFile {
+    int fd;
+
+   public:
+    explicit InputFile(const string& path);
+
+    InputFile(const InputFile&) = delete;
+    InputFile& operator=(const InputFile&) = delete;
+
+    ~InputFile();
+
+    int get_fd() const {
+        return fd;
+    }
+};
+
+// A regular file mapped into memory from a given offset to its end. The kernel is advised that the
+// mapping will be read sequentially (so that it reads ahead aggressively). The mapping is shared,
+// so it reflects later changes to the file (and reading past the end of a file truncated while it
+// is mapped raises SIGBUS): it should only be read by converters that copy the values out of it,
+// and released once they are done.
+class MappedFile {
+    void* mapping = nullptr;
+    size_t mapping_size = 0;
+    const char* data = nullptr;
+    size_t size = 0;
+
+    MappedFile() = default;
+
+   public:
+    // returns null if the descriptor can not be mapped (e.g. if it is a pipe); the mapping does not
+    // depend on the descriptor staying open
+    static unique_ptr<MappedFile> map(int fd, int64_t offset);
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    ~MappedFile();
+
+    const char* get_data() const {
+        return data;
+    }
+
+    size_t get_size() const {
+        return size;
+    }
+};
+
+// advises the kernel that the descriptor will be read sequentially from the given offset (where
+// this is supported)
+void advise_sequential(int fd, int64_t offset);
+
+}  // namespace bamboo
@@ -25,75 +25,208 @@ namespace json {
 
 namespace json = nlohmann;
 
-typedef KeyValueIterator<const string, json::json&> FieldIteratorType;
-typedef ValueIterator<json::json&> ListIteratorType;
+// The functions adding each kind of JSON value to a primitive node of a given type (converting it to
+// the type, or throwing if it does not fit). They are bound once the node a value goes to is known,
+// so that the node's type is not checked again for each value.
+struct PrimitiveAppender {
+    void (*add_bool)(PrimitiveNode& node, bool value);
+    void (*add_int)(PrimitiveNode& node, int64_t value);
+    void (*add_uint)(PrimitiveNode& node, uint64_t value);
+    void (*add_double)(PrimitiveNode& node, double value);
+
+    void add(PrimitiveNode& node, bool value) const {
+        add_bool(node, value);
+    }
 
-class FieldIterator final : public FieldIteratorType {
-    json::json::iterator it;
-    json::json::iterator end;
-    bool has_started = false;
+    void add(PrimitiveNode& node, int64_t value) const {
+        add_int(node, value);
+    }
 
-   public:
-    FieldIterator(json::json& datum) : it(datum.begin()), end(datum.end()){};
+    void add(PrimitiveNode& node, uint64_t value) const {
+        add_uint(node, value);
+    }
+
+    void add(PrimitiveNode& node, double value) const {
+        add_double(node, value);
+    }
+
+    // the appender for nodes of the given type, or null if it has none (e.g. an untyped node, or
+    // a string node, to which these values can not be added)
+    static const PrimitiveAppender* get(PrimitiveType type);
+};
+
+// A SAX handler for nlohmann's parser (and for the in memory parser) that appends each value to the
+// nodes as it is parsed, so that no document tree is built (the memory used is that of the nodes).
+// Record fields missing from an object are filled with nulls. Values that do not pass the column
+// filter are dropped: whole object members are skipped if nothing under them can be included (the
+// in memory parser then skips them without decoding them).
+class JsonHandler {
+    // an open object or array
+    struct Frame {
+        Node* node;
+        // the number of values added to an array (or, for an object, the number of non-null
+        // entries its record had before the object)
+        size_t count;
+        // the filter of the object or array
+        const ColumnFilter* column_filter;
+        bool implicit_include;
+        // the node and filter of the current member of an object
+        unique_ptr<Node>* field = nullptr;
+        const ColumnFilter* field_filter = nullptr;
+        bool field_implicit_include = false;
+        // the typed primitive node the next value is added to, once it is known (the entries of an
+        // array, or the current member of an object), and the appender bound to it
+        PrimitiveNode* primitive = nullptr;
+        const PrimitiveAppender* appender = nullptr;
+    };
+
+    unique_ptr<Node>& root;
+    const ColumnFilter* column_filter;
+    bool implicit_include;
+    // a hint for the number of entries of the outermost array
+    size_t expected_rows;
+    vector<Frame> frames;
+    // set once a member has been skipped (until its value has been read), and the depth of the
+    // objects and arrays within the value
+    bool skip_value = false;
+    size_t skip_depth = 0;
+
+    // whether the next value is skipped (and if so, accounts for it)
+    bool skipped(bool starts_container);
+
+    // the filter of the next value
+    const ColumnFilter* value_filter(bool& value_implicit_include) const;
+
+    // the node the next value is added to, typed (or checked against) the value's type
+    Node& target(ObjType type);
+
+    // called once a value (including a whole object or array) has been added
+    void added();
+
+    // binds the frame's next values to the node, if it is a typed primitive node
+    static void bind(Frame& frame, Node& node);
+
+    // values are converted to the type of the node they are added to where they fit in it (which
+    // allows, for example, integers in a floating point column, as a schema may declare)
+    static void add_value(PrimitiveNode& node, bool value);
+
+    static void add_value(PrimitiveNode& node, int64_t value);
+
+    static void add_value(PrimitiveNode& node, uint64_t value);
 
-    virtual ~FieldIterator() final override = default;
+    static void add_value(PrimitiveNode& node, double value);
 
-    virtual bool next() final override {
-        if (!has_started) {
-            has_started = true;
+    template <class T> bool primitive(const T& value) {
+        bool value_implicit_include;
+        const ColumnFilter* filter = value_filter(value_implicit_include);
+        if (skipped(false) || !ColumnFilter::included(filter, value_implicit_include)) {
+            return true;
+        }
+        Frame* frame = frames.empty() ? nullptr : &frames.back();
+        if (frame && frame->primitive) {
+            frame->appender->add(*frame->primitive, value);
+            frame->primitive->add_not_null();
         } else {
-            it++;
+            PrimitiveNode& node = static_cast<PrimitiveNode&>(target(ObjType::PRIMITIVE));
+            add_value(node, value);
+            node.add_not_null();
+            // (the entries of an array are typed by the first of them)
+            if (frame && frame->node->type == ObjType::LIST) {
+                bind(*frame, node);
+            }
         }
-        return it != end;
+        added();
+        return true;
     }
 
-    virtual const string key() final override {
-        return it.key();
+   public:
+    JsonHandler(unique_ptr<Node>& root, const ColumnFilter* column_filter,
+                size_t expected_rows = 0)
+        : root(root),
+          column_filter(column_filter),
+          implicit_include(!column_filter || !column_filter->has_includes()),
+          expected_rows(expected_rows) {}
+
+    // whether the member named by the last key is skipped (in which case the parser may skip its
+    // value without passing it to the handler, calling member_skipped instead)
+    bool skipping_member() const {
+        return skip_value;
     }
 
-    virtual json::json& value() final override {
-        return it.value();
+    void member_skipped() {
+        skip_value = false;
     }
-};
 
-class ListIterator final : public ListIteratorType {
-    json::json::iterator it;
-    json::json::iterator end;
-    bool has_started = false;
+    bool null();
 
-   public:
-    ListIterator(json::json& datum) : it(datum.begin()), end(datum.end()){};
+    bool boolean(bool value) {
+        return primitive(value);
+    }
 
-    virtual ~ListIterator() final override = default;
+    bool number_integer(int64_t value) {
+        return primitive(value);
+    }
 
-    virtual bool next() override {
-        if (!has_started) {
-            has_started = true;
-        } else {
-            it++;
-        }
-        return it != end;
-    };
+    bool number_unsigned(uint64_t value) {
+        return primitive(value);
+    }
 
-    virtual json::json& value() override {
-        return *it;
+    bool number_float(double value, const std::string&) {
+        return primitive(value);
     }
-};
 
-class JsonConverter final : public virtual Converter<json::json&, FieldIterator, ListIterator> {
-   public:
-    virtual ObjType type(json::json& datum) final override;
+    bool string(std::string& value) {
+        return string(value.data(), value.size());
+    }
 
-    virtual FieldIterator fields(json::json& datum) final override;
+    bool string(const char* data, size_t size);
+
+    // (only produced by the binary formats)
+    template <class B> bool binary(B&) {
+        throw std::invalid_argument("Unexpected binary value in JSON");
+    }
 
-    virtual ListIterator get_list(json::json& datum) final override;
+    bool start_object(size_t);
 
-    virtual void add_primitive(PrimitiveNode& v, json::json& datum) final override;
+    bool key(std::string& name);
 
-    virtual ~JsonConverter() final override = default;
+    bool end_object();
+
+    bool start_array(size_t);
+
+    bool end_array();
+
+    template <class E> bool parse_error(size_t, const std::string&, const E& error) {
+        throw std::invalid_argument(error.what());
+    }
 };
 
-unique_ptr<Node> convert(std::istream& is, const ColumnFilter* column_filter);
+// Builds the (empty) nodes described by an Avro schema (given as JSON), typed as it declares, to be
+// used as the schema of a conversion. Unions of null and one other type are taken to be that type
+// (as every node is nullable); maps, fixed, bytes and other unions are not supported.
+unique_ptr<Node> schema_from_avro(const std::string& avro_schema);
+
+// Members that the column filter leaves out are not converted; when parsing from memory their
+// values are passed over without being tokenized. With a schema (such as one built by
+// schema_from_avro, or a node from an earlier conversion), the nodes are created with its structure
+// and primitive types up front rather than as values are first seen, and numbers are converted to
+// the declared types. Fields that the schema does not declare are still found as they are parsed.
+// expected_rows (if non-zero) is a hint for the number of entries of the outermost array.
+unique_ptr<Node> convert(std::istream& is, const ColumnFilter* column_filter, const Node* schema,
+                         size_t expected_rows);
+
+unique_ptr<Node> convert(const char* data, size_t size, const ColumnFilter* column_filter,
+                         const Node* schema, size_t expected_rows);
+
+// Converts newline delimited JSON (JSON Lines) to a list with an entry for each (non-blank) line
+// (of which the schema, if any, describes one). With more than one thread (or zero, for one per
+// core), the input is split at line boundaries and the ranges are parsed in parallel. expected_rows
+// (if non-zero) is a hint for the number of lines.
+unique_ptr<Node> convert_lines(std::istream& is, const ColumnFilter* column_filter,
+                               const Node* schema, size_t expected_rows, size_t threads);
+
+unique_ptr<Node> convert_lines(const char* data, size_t size, const ColumnFilter* column_filter,
+                               const Node* schema, size_t expected_rows, size_t threads);
 
 }  // namespace json
 }  // namespace bamboo
@@ -0,0 +1,77 @@
+// Copyright (c) 2019 Michael Vilim
+//
+// This file is part of the bamboo library. It is currently hosted at
+// https://github.com/mvilim/bamboo
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace bamboo {
+namespace json {
+
+using std::string;
+using std::vector;
+
+struct BlockMasks;
+
+// the names of the block classifiers the processor supports ("avx2", "sse4.2" and "scalar"), the
+// fastest first
+vector<string> classifiers();
+
+// the classifier used by indexers reset from now on (the fastest supported one, unless the
+// BAMBOO_JSON_CLASSIFIER environment variable names another supported one when the library is
+// loaded); this is meant for testing the classifiers against each other
+string get_classifier();
+void set_classifier(const string& name);
+
+// Finds the structural characters of JSON held in memory: the brackets, colons and commas outside
+// of strings, the (unescaped) quotes that open and close strings and the first character of each
+// number or literal. The input is classified 64 bytes at a time, with AVX2 or SSE4.2 where the
+// processor supports them, and is indexed a window at a time so that the index of a large document
+// is never held whole.
+class StructuralIndexer {
+    const char* pos = nullptr;
+    const char* end = nullptr;
+    // carried from one block to the next: whether the next block starts with an escaped character
+    // (in the lowest bit), within a string (in every bit) or within a number or literal (in the
+    // lowest bit)
+    uint64_t escaped = 0;
+    uint64_t in_string = 0;
+    uint64_t in_scalar = 0;
+    // the first control character found within a string (which is not allowed there)
+    const char* control = nullptr;
+    void (*classify)(const char* block, BlockMasks& masks) = nullptr;
+
+    // appends the structural characters of the block (at base in the input) to positions
+    void index_block(const char* block, const char* base, vector<const char*>& positions);
+
+   public:
+    void reset(const char* begin, const char* end);
+
+    // replaces positions with those of the structural characters in the next window of the input,
+    // returning false once the whole input has been indexed
+    bool next(vector<const char*>& positions);
+
+    const char* first_control() const {
+        return control;
+    }
+};
+
+}  // namespace json
+}  // namespace bamboo
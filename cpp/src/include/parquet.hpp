@@ -0,0 +1,34 @@
+// Copyright (c) 2019 Michael Vilim
+//
+// This file is part of the bamboo library. It is currently hosted at
+// https://github.com/mvilim/bamboo
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <columns.hpp>
+
+namespace bamboo {
+namespace parquet {
+
+// Reads a Parquet file (by memory mapping it), converting its row groups in parallel on the given
+// number of threads (0 for one per core). Only the column chunks that pass the filter are read, and
+// nested values are built directly from the repetition and definition levels of the leaf columns.
+// expected_rows (if non-zero) is a hint for the number of rows read, in place of the row count in
+// the file's metadata.
+unique_ptr<Node> convert_file(const string& path, const ColumnFilter* column_filter,
+                              size_t expected_rows, size_t threads);
+
+}  // namespace parquet
+}  // namespace bamboo
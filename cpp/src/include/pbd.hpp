@@ -83,9 +83,6 @@ struct Datum {
     };
 };
 
-typedef KeyValueIterator<const int, Datum&> FieldIteratorType;
-typedef ValueIterator<Datum&> ListIteratorType;
-
 // we can probably reuse the iterator instances (by building the schema with all necessary
 // references at the beginning)
 
@@ -100,7 +97,7 @@ static inline Datum selectDatum(Datum& datum) {
     }
 }
 
-class FieldIterator final : public FieldIteratorType {
+class FieldIterator {
     Datum datum;
     Limit limit;
     int field_index;
@@ -126,8 +123,6 @@ class FieldIterator final : public FieldIteratorType {
         current = begin;
     };
 
-    ~FieldIterator() final override = default;
-
     bool nextMissing() {
         current = std::find(current, end, false);
         field_index = std::distance(begin, current);
@@ -141,7 +136,7 @@ class FieldIterator final : public FieldIteratorType {
         return true;
     }
 
-    bool next() final override {
+    bool next() {
         while (true) {
             if (datum.reading_missing) {
                 return nextMissing();
@@ -208,20 +203,39 @@ class FieldIterator final : public FieldIteratorType {
         }
     }
 
-    const int key() final override {
+    const int key() {
         return field_index;
     }
 
-    Datum& value() final override {
+    Datum& value() {
         return datum;
     }
 };
 
-class ListIterator final : public ListIteratorType {
+// the encoded size of a packed value, or 0 for variable size (varint) values
+static size_t packed_value_size(pb::FieldDescriptor::Type type) {
+    switch (type) {
+        case pb::FieldDescriptor::TYPE_BOOL:
+            return 1;
+        case pb::FieldDescriptor::TYPE_FLOAT:
+        case pb::FieldDescriptor::TYPE_FIXED32:
+        case pb::FieldDescriptor::TYPE_SFIXED32:
+            return 4;
+        case pb::FieldDescriptor::TYPE_DOUBLE:
+        case pb::FieldDescriptor::TYPE_FIXED64:
+        case pb::FieldDescriptor::TYPE_SFIXED64:
+            return 8;
+        default:
+            return 0;
+    }
+}
+
+class ListIterator {
     Datum& datum;
     bool packed;
     Limit limit;
     bool read_first = false;
+    size_t hint = 0;
 
    public:
     ListIterator(Datum& datum) : datum(datum) {
@@ -236,15 +250,21 @@ class ListIterator final : public ListIteratorType {
                 datum.field->pb_field->is_packable()) {
                 packed = true;
                 limit = datum.stream.ReadLengthAndPushLimit();
+                size_t value_size = packed_value_size(datum.field->pb_field->type());
+                if (value_size) {
+                    hint = datum.stream.BytesUntilLimit() / value_size;
+                }
             } else {
                 packed = false;
             }
         }
     };
 
-    ~ListIterator() final override = default;
+    size_t size_hint() {
+        return hint;
+    }
 
-    bool next() final override {
+    bool next() {
         if (datum.reading_missing) {
             datum.reading_list = false;
             return false;
@@ -280,25 +300,30 @@ class ListIterator final : public ListIteratorType {
         }
     };
 
-    Datum& value() final override {
+    Datum& value() {
         return datum;
     }
 };
 
-class PBDConverter final : public virtual Converter<Datum&, FieldIterator, ListIterator> {
+class PBDConverter final
+    : public StaticConverter<PBDConverter, Datum&, FieldIterator, ListIterator> {
    public:
-    virtual ObjType type(Datum& datum) final override;
+    ObjType type(Datum& datum);
 
-    virtual FieldIterator fields(Datum& datum) final override;
+    FieldIterator fields(Datum& datum);
 
-    virtual ListIterator get_list(Datum& datum) final override;
+    ListIterator get_list(Datum& datum);
 
-    virtual void add_primitive(PrimitiveNode& v, Datum& datum) final override;
-
-    virtual ~PBDConverter() final override = default;
+    void add_primitive(PrimitiveNode& v, Datum& datum);
 };
 
-unique_ptr<Node> convert(std::istream& is, const ColumnFilter* column_filter);
+// expected_rows (if non-zero) is a hint for the number of messages in the stream
+unique_ptr<Node> convert(std::istream& is, const ColumnFilter* column_filter,
+                         size_t expected_rows);
+
+// converts a stream held in memory (which must outlive the call)
+unique_ptr<Node> convert(const char* data, size_t size, const ColumnFilter* column_filter,
+                         size_t expected_rows);
 
 }  // namespace pbd
 }  // namespace bamboo
@@ -17,7 +17,12 @@
 
 #pragma once
 
+#include <algorithm>
+#include <exception>
 #include <memory>
+#include <thread>
+#include <utility>
+#include <vector>
 
 namespace bamboo {
 template <typename T, typename... Args> std::unique_ptr<T> make_unique(Args&&... args) {
@@ -27,4 +32,65 @@ template <typename T, typename... Args> std::unique_ptr<T> make_unique(Args&&...
 template <typename T, typename... Args> std::shared_ptr<T> make_shared(Args&&... args) {
     return std::shared_ptr<T>(new T(std::forward<Args>(args)...));
 }
+
+// Worker threads that are joined when the group is destroyed, so that an exception thrown while
+// they are being started (or while the calling thread works alongside them) never destroys a
+// thread that is still joinable (which would terminate the process).
+class ThreadGroup {
+    std::vector<std::thread> threads;
+
+   public:
+    ThreadGroup() = default;
+    ThreadGroup(const ThreadGroup&) = delete;
+    ThreadGroup& operator=(const ThreadGroup&) = delete;
+
+    template <typename... Args> void spawn(Args&&... args) {
+        threads.emplace_back(std::forward<Args>(args)...);
+    }
+
+    void join() {
+        for (std::thread& thread : threads) {
+            if (thread.joinable()) {
+                thread.join();
+            }
+        }
+    }
+
+    ~ThreadGroup() {
+        join();
+    }
+};
+
+// the number of threads to use for a requested count (0 for one per core)
+inline size_t thread_count(size_t threads) {
+    return threads == 0 ? std::max(1u, std::thread::hardware_concurrency()) : threads;
+}
+
+// Calls fn(i) for each i in [0, tasks), each on its own thread (the calling thread runs the first).
+// All of the threads are joined (even if starting one fails), and then the first error thrown by a
+// task (in task order) is rethrown.
+template <typename F> void parallel_for(size_t tasks, F fn) {
+    std::vector<std::exception_ptr> errors(tasks);
+    auto run = [&fn, &errors](size_t i) {
+        try {
+            fn(i);
+        } catch (...) {
+            errors[i] = std::current_exception();
+        }
+    };
+    {
+        ThreadGroup workers;
+        for (size_t i = 1; i < tasks; i++) {
+            workers.spawn(run, i);
+        }
+        if (tasks > 0) {
+            run(0);
+        }
+    }
+    for (std::exception_ptr& error : errors) {
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+}
 }  // namespace bamboo
@@ -15,65 +15,1241 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <algorithm>
+#include <cerrno>
+#include <clocale>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
 #include <json.hpp>
+#include <json_index.hpp>
+#include <limits>
+#include <util.hpp>
 
 namespace bamboo {
 namespace json {
 
-using value_t = json::detail::value_t;
+// the first byte of [begin, end) that is not part of a valid UTF-8 sequence (or end), passing over
+// ASCII eight bytes at a time
+static const char* invalid_utf8(const char* begin, const char* end) {
+    const unsigned char* pos = reinterpret_cast<const unsigned char*>(begin);
+    const unsigned char* last = reinterpret_cast<const unsigned char*>(end);
+    while (pos < last) {
+        uint64_t word;
+        if (last - pos >= 8 && (std::memcpy(&word, pos, 8), !(word & 0x8080808080808080ULL))) {
+            pos += 8;
+            continue;
+        }
+        unsigned char c = *pos;
+        if (c < 0x80) {
+            pos++;
+            continue;
+        }
+        // the length of the sequence and the range of its second byte (which excludes overlong
+        // encodings, surrogates and code points past U+10FFFF)
+        size_t length;
+        unsigned char low = 0x80;
+        unsigned char high = 0xBF;
+        if (c >= 0xC2 && c <= 0xDF) {
+            length = 2;
+        } else if (c >= 0xE0 && c <= 0xEF) {
+            length = 3;
+            low = c == 0xE0 ? 0xA0 : 0x80;
+            high = c == 0xED ? 0x9F : 0xBF;
+        } else if (c >= 0xF0 && c <= 0xF4) {
+            length = 4;
+            low = c == 0xF0 ? 0x90 : 0x80;
+            high = c == 0xF4 ? 0x8F : 0xBF;
+        } else {
+            break;
+        }
+        if (static_cast<size_t>(last - pos) < length || pos[1] < low || pos[1] > high) {
+            break;
+        }
+        size_t i = 2;
+        while (i < length && pos[i] >= 0x80 && pos[i] <= 0xBF) {
+            i++;
+        }
+        if (i < length) {
+            break;
+        }
+        pos += length;
+    }
+    return reinterpret_cast<const char*>(pos);
+}
+
+// A parser for JSON held in memory, which drives the handler in the same way as nlohmann's SAX
+// parser. It moves between the structural characters found by the indexer, so whitespace and the
+// contents of strings are never looked at a character at a time: strings without escapes are passed
+// to the handler where they are, and the runs between escapes are copied whole. Object members that
+// the handler skips are passed over by matching their brackets, without decoding (or validating)
+// their numbers and literals.
+class JsonParser {
+    const char* begin;
+    const char* pos;
+    const char* end;
+    JsonHandler& handler;
+    StructuralIndexer indexer;
+    // the structural characters of the current window, and the next of them
+    vector<const char*> positions;
+    size_t next_position;
+    // the open objects and arrays (by their opening bracket)
+    vector<char> open;
+    std::string buffer;
+    std::string key;
+
+    [[noreturn]] void error(const string& message) {
+        throw std::invalid_argument("JSON parse error at offset " + std::to_string(pos - begin) +
+                                    ": " + message);
+    }
+
+    // whether there is another structural character (indexing the next window if needed)
+    bool more() {
+        while (next_position == positions.size()) {
+            if (!indexer.next(positions)) {
+                return false;
+            }
+            next_position = 0;
+        }
+        return true;
+    }
+
+    // moves past the next structural character, returning it
+    char next() {
+        if (!more()) {
+            pos = end;
+            error("unexpected end of input");
+        }
+        const char* position = positions[next_position++];
+        pos = position + 1;
+        return *position;
+    }
+
+    // moves back to the last structural character
+    void back() {
+        next_position--;
+        pos = positions[next_position];
+    }
+
+    void literal(const char* expected, size_t length) {
+        if (static_cast<size_t>(end - pos) < length || std::memcmp(pos, expected, length) != 0) {
+            error("invalid literal");
+        }
+        pos += length;
+    }
+
+    // a number or literal runs up to whitespace, a structural character or the end of the input
+    void end_scalar(const char* message) {
+        if (pos == end) {
+            return;
+        }
+        switch (*pos) {
+            case ' ':
+            case '\t':
+            case '\n':
+            case '\r':
+            case '{':
+            case '}':
+            case '[':
+            case ']':
+            case ':':
+            case ',':
+            case '"':
+                return;
+            default:
+                error(message);
+        }
+    }
+
+    uint32_t hex4() {
+        if (end - pos < 4) {
+            error("invalid unicode escape");
+        }
+        uint32_t value = 0;
+        for (size_t i = 0; i < 4; i++) {
+            char c = *pos++;
+            value <<= 4;
+            if (c >= '0' && c <= '9') {
+                value |= c - '0';
+            } else if (c >= 'a' && c <= 'f') {
+                value |= c - 'a' + 10;
+            } else if (c >= 'A' && c <= 'F') {
+                value |= c - 'A' + 10;
+            } else {
+                error("invalid unicode escape");
+            }
+        }
+        return value;
+    }
+
+    void append_utf8(uint32_t code_point) {
+        if (code_point < 0x80) {
+            buffer.push_back(code_point);
+        } else if (code_point < 0x800) {
+            buffer.push_back(0xC0 | (code_point >> 6));
+            buffer.push_back(0x80 | (code_point & 0x3F));
+        } else if (code_point < 0x10000) {
+            buffer.push_back(0xE0 | (code_point >> 12));
+            buffer.push_back(0x80 | ((code_point >> 6) & 0x3F));
+            buffer.push_back(0x80 | (code_point & 0x3F));
+        } else {
+            buffer.push_back(0xF0 | (code_point >> 18));
+            buffer.push_back(0x80 | ((code_point >> 12) & 0x3F));
+            buffer.push_back(0x80 | ((code_point >> 6) & 0x3F));
+            buffer.push_back(0x80 | (code_point & 0x3F));
+        }
+    }
+
+    void escape() {
+        if (pos == end) {
+            error("unexpected end of input");
+        }
+        switch (*pos++) {
+            case '"':
+                buffer.push_back('"');
+                break;
+            case '\\':
+                buffer.push_back('\\');
+                break;
+            case '/':
+                buffer.push_back('/');
+                break;
+            case 'b':
+                buffer.push_back('\b');
+                break;
+            case 'f':
+                buffer.push_back('\f');
+                break;
+            case 'n':
+                buffer.push_back('\n');
+                break;
+            case 'r':
+                buffer.push_back('\r');
+                break;
+            case 't':
+                buffer.push_back('\t');
+                break;
+            case 'u': {
+                uint32_t code_point = hex4();
+                if (code_point >= 0xD800 && code_point <= 0xDBFF) {
+                    // a surrogate pair
+                    if (end - pos < 2 || pos[0] != '\\' || pos[1] != 'u') {
+                        error("unpaired surrogate");
+                    }
+                    pos += 2;
+                    uint32_t low = hex4();
+                    if (low < 0xDC00 || low > 0xDFFF) {
+                        error("unpaired surrogate");
+                    }
+                    code_point = 0x10000 + ((code_point - 0xD800) << 10) + (low - 0xDC00);
+                } else if (code_point >= 0xDC00 && code_point <= 0xDFFF) {
+                    error("unpaired surrogate");
+                }
+                append_utf8(code_point);
+                break;
+            }
+            default:
+                error("invalid escape");
+        }
+    }
+
+    // the closing quote of the string whose opening quote has just been read (the indexer finds
+    // any control characters within it)
+    const char* close_string() {
+        const char* start = pos;
+        if (!more()) {
+            error("unterminated string");
+        }
+        const char* close = positions[next_position++];
+        const char* control = indexer.first_control();
+        if (control && control >= start && control < close) {
+            pos = control;
+            error("control character in string");
+        }
+        return close;
+    }
+
+    // reads the string whose opening quote has just been read, which is either left where it is in
+    // the input or unescaped into the buffer
+    void read_string(const char*& data, size_t& size) {
+        const char* start = pos;
+        const char* close = close_string();
+        const char* invalid = invalid_utf8(start, close);
+        if (invalid != close) {
+            pos = invalid;
+            error("invalid UTF-8 in string");
+        }
+        const char* backslash = static_cast<const char*>(std::memchr(start, '\\', close - start));
+        if (!backslash) {
+            data = start;
+            size = close - start;
+            pos = close + 1;
+            return;
+        }
+        buffer.assign(start, backslash);
+        pos = backslash;
+        while (pos < close) {
+            pos++;
+            escape();
+            // (an escape cannot run past the closing quote, as it would have escaped it)
+            const char* run = pos;
+            backslash = static_cast<const char*>(std::memchr(run, '\\', close - run));
+            pos = backslash ? backslash : close;
+            buffer.append(run, pos);
+        }
+        pos = close + 1;
+        data = buffer.data();
+        size = buffer.size();
+    }
+
+    // strtod reads the decimal point of the current (LC_NUMERIC) locale, so a JSON number is
+    // given to it with that decimal point in place of '.'
+    static double parse_double(const std::string& number) {
+        char decimal_point = *std::localeconv()->decimal_point;
+        if (decimal_point == '.' || number.find('.') == std::string::npos) {
+            return std::strtod(number.c_str(), nullptr);
+        }
+        std::string localized = number;
+        std::replace(localized.begin(), localized.end(), '.', decimal_point);
+        return std::strtod(localized.c_str(), nullptr);
+    }
+
+    // Clinger's fast path: a decimal whose digits (at most 19 of them) a double holds exactly,
+    // scaled by a power of ten that a double also holds exactly, is correctly rounded by a single
+    // multiplication or division
+    static bool fast_float(const char* integer, const char* integer_end, const char* fraction,
+                           const char* fraction_end, int64_t exponent, double& value) {
+        static const double powers[] = {1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,
+                                        1e8,  1e9,  1e10, 1e11, 1e12, 1e13, 1e14, 1e15,
+                                        1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+        if ((integer_end - integer) + (fraction_end - fraction) > 19) {
+            return false;
+        }
+        uint64_t mantissa = 0;
+        for (const char* digit = integer; digit < integer_end; digit++) {
+            mantissa = mantissa * 10 + (*digit - '0');
+        }
+        for (const char* digit = fraction; digit < fraction_end; digit++) {
+            mantissa = mantissa * 10 + (*digit - '0');
+        }
+        exponent -= fraction_end - fraction;
+        if (mantissa > (uint64_t(1) << 53) || exponent < -22 || exponent > 22) {
+            return false;
+        }
+        value = static_cast<double>(mantissa);
+        value = exponent < 0 ? value / powers[-exponent] : value * powers[exponent];
+        return true;
+    }
+
+    // numbers are passed on with the same types as nlohmann's parser uses: unsigned for
+    // non-negative integers, signed for negative ones and floating point otherwise (including
+    // integers that do not fit)
+    void number() {
+        const char* start = pos - 1;
+        bool negative = *start == '-';
+        if (negative && (pos == end || *pos < '0' || *pos > '9')) {
+            error("invalid number");
+        }
+        const char* digits = negative ? pos : start;
+        if (*digits == '0') {
+            pos = digits + 1;
+        }
+        while (pos < end && *pos >= '0' && *pos <= '9') {
+            pos++;
+        }
+        if (pos - digits > 1 && *digits == '0') {
+            error("invalid number");
+        }
+        const char* digits_end = pos;
+        const char* fraction = pos;
+        const char* fraction_end = pos;
+        int64_t exponent = 0;
+        bool integer = true;
+        if (pos < end && *pos == '.') {
+            integer = false;
+            fraction = ++pos;
+            while (pos < end && *pos >= '0' && *pos <= '9') {
+                pos++;
+            }
+            if (pos == fraction) {
+                error("invalid number");
+            }
+            fraction_end = pos;
+        }
+        if (pos < end && (*pos == 'e' || *pos == 'E')) {
+            integer = false;
+            pos++;
+            bool negative_exponent = false;
+            if (pos < end && (*pos == '+' || *pos == '-')) {
+                negative_exponent = *pos++ == '-';
+            }
+            const char* exponent_digits = pos;
+            while (pos < end && *pos >= '0' && *pos <= '9') {
+                // (large exponents are left to strtod)
+                exponent = std::min<int64_t>(exponent * 10 + (*pos - '0'), 100000);
+                pos++;
+            }
+            if (pos == exponent_digits) {
+                error("invalid number");
+            }
+            if (negative_exponent) {
+                exponent = -exponent;
+            }
+        }
+
+        if (integer) {
+            uint64_t value = 0;
+            bool overflow = false;
+            for (const char* digit = digits; digit < pos; digit++) {
+                uint64_t next_value = value * 10 + (*digit - '0');
+                overflow |= value > UINT64_MAX / 10 || next_value < value * 10;
+                value = next_value;
+            }
+            if (!negative && !overflow) {
+                handler.number_unsigned(value);
+                return;
+            }
+            if (negative && !overflow && value <= static_cast<uint64_t>(INT64_MAX) + 1) {
+                handler.number_integer(static_cast<int64_t>(0 - value));
+                return;
+            }
+        }
+        double value;
+        if (fast_float(digits, digits_end, fraction, fraction_end, exponent, value)) {
+            buffer.clear();
+            handler.number_float(negative ? -value : value, buffer);
+            return;
+        }
+        // (the input may not be null terminated)
+        buffer.assign(start, pos);
+        errno = 0;
+        value = parse_double(buffer);
+        if (errno == ERANGE && std::abs(value) > 1) {
+            error("number out of range");
+        }
+        handler.number_float(value, buffer);
+    }
+
+    // passes over a value (whose first structural character, c, has just been read) by matching
+    // its brackets
+    void skip(char c) {
+        size_t depth = open.size();
+        while (true) {
+            switch (c) {
+                case '"':
+                    pos = close_string() + 1;
+                    break;
+                case '{':
+                case '[':
+                    open.push_back(c);
+                    break;
+                case '}':
+                case ']':
+                    if (open.size() == depth || open.back() != (c == '}' ? '{' : '[')) {
+                        back();
+                        error("unexpected character");
+                    }
+                    open.pop_back();
+                    break;
+                case ':':
+                case ',':
+                    if (open.size() == depth) {
+                        back();
+                        error("unexpected character");
+                    }
+                    break;
+            }
+            if (open.size() == depth) {
+                return;
+            }
+            c = next();
+        }
+    }
+
+    // reads a value, returning false if it opened an object or array (whose contents follow)
+    bool value() {
+        char c = next();
+        switch (c) {
+            case '{':
+                handler.start_object(-1);
+                open.push_back(c);
+                return false;
+            case '[':
+                handler.start_array(-1);
+                open.push_back(c);
+                return false;
+            case '"': {
+                const char* data;
+                size_t size;
+                read_string(data, size);
+                handler.string(data, size);
+                return true;
+            }
+            case 't':
+                literal("rue", 3);
+                end_scalar("invalid literal");
+                handler.boolean(true);
+                return true;
+            case 'f':
+                literal("alse", 4);
+                end_scalar("invalid literal");
+                handler.boolean(false);
+                return true;
+            case 'n':
+                literal("ull", 3);
+                end_scalar("invalid literal");
+                handler.null();
+                return true;
+            default:
+                if (c == '-' || (c >= '0' && c <= '9')) {
+                    number();
+                    end_scalar("invalid number");
+                    return true;
+                }
+                back();
+                error("unexpected character");
+        }
+    }
+
+    // reads a member of an object (its key and value), returning false if its value opened an
+    // object or array
+    bool member() {
+        if (next() != '"') {
+            back();
+            error("expected a key");
+        }
+        const char* data;
+        size_t size;
+        read_string(data, size);
+        key.assign(data, size);
+        handler.key(key);
+        if (next() != ':') {
+            back();
+            error("expected ':'");
+        }
+        if (handler.skipping_member()) {
+            skip(next());
+            handler.member_skipped();
+            return true;
+        }
+        return value();
+    }
+
+    // reads the next entry of the innermost open object or array (or closes it), returning false
+    // if the entry opened an object or array
+    bool entry(bool first) {
+        char close = open.back() == '{' ? '}' : ']';
+        char c = next();
+        if (c == close) {
+            open.pop_back();
+            if (close == '}') {
+                handler.end_object();
+            } else {
+                handler.end_array();
+            }
+            return true;
+        }
+        if (first) {
+            back();
+        } else if (c != ',') {
+            back();
+            error(string("expected ',' or '") + close + "'");
+        }
+        return close == '}' ? member() : value();
+    }
+
+   public:
+    explicit JsonParser(JsonHandler& handler)
+        : begin(nullptr), pos(nullptr), end(nullptr), handler(handler), next_position(0) {}
+
+    // parses a single value held in [begin, end) (followed by nothing but whitespace); the parser
+    // may be reused for any number of values
+    void parse(const char* begin, const char* end) {
+        this->begin = begin;
+        this->end = end;
+        pos = begin;
+        indexer.reset(begin, end);
+        positions.clear();
+        next_position = 0;
+        open.clear();
+
+        bool complete = value();
+        while (!open.empty()) {
+            complete = entry(!complete);
+        }
+        if (more()) {
+            pos = positions[next_position];
+            error("unexpected data after value");
+        }
+    }
+};
 
-unique_ptr<Node> convert(std::istream& is, const ColumnFilter* column_filter) {
-    json::json j;
-    is >> j;
-    JsonConverter converter;
-    unique_ptr<Node> node = make_unique<IncompleteNode>();
-    converter.convert(node, j);
+// an empty node with the structure and primitive types of schema
+static unique_ptr<Node> empty_copy(const Node& schema) {
+    switch (schema.type) {
+        case ObjType::RECORD: {
+            const RecordNode& schema_record = static_cast<const RecordNode&>(schema);
+            unique_ptr<RecordNode> node = make_unique<RecordNode>();
+            for (size_t i = 0; i < schema_record.get_field_count(); i++) {
+                node->get_field(schema_record.get_fields()[i]) =
+                    empty_copy(*schema_record.get_field(i));
+            }
+            return std::move(node);
+        }
+        case ObjType::LIST: {
+            unique_ptr<ListNode> node = make_unique<ListNode>();
+            node->get_list() = empty_copy(*static_cast<const ListNode&>(schema).get_list());
+            return std::move(node);
+        }
+        case ObjType::PRIMITIVE: {
+            unique_ptr<PrimitiveNode> node = make_unique<PrimitiveNode>();
+            switch (static_cast<const PrimitiveNode&>(schema).get_type()) {
+                case PrimitiveType::EMPTY:
+                    break;
+                case PrimitiveType::BOOL:
+                    node->init_type<PrimitiveType::BOOL>();
+                    break;
+                case PrimitiveType::INT8:
+                    node->init_type<PrimitiveType::INT8>();
+                    break;
+                case PrimitiveType::INT16:
+                    node->init_type<PrimitiveType::INT16>();
+                    break;
+                case PrimitiveType::INT32:
+                    node->init_type<PrimitiveType::INT32>();
+                    break;
+                case PrimitiveType::INT64:
+                    node->init_type<PrimitiveType::INT64>();
+                    break;
+                case PrimitiveType::UINT8:
+                    node->init_type<PrimitiveType::UINT8>();
+                    break;
+                case PrimitiveType::UINT16:
+                    node->init_type<PrimitiveType::UINT16>();
+                    break;
+                case PrimitiveType::UINT32:
+                    node->init_type<PrimitiveType::UINT32>();
+                    break;
+                case PrimitiveType::UINT64:
+                    node->init_type<PrimitiveType::UINT64>();
+                    break;
+                case PrimitiveType::FLOAT32:
+                    node->init_type<PrimitiveType::FLOAT32>();
+                    break;
+                case PrimitiveType::FLOAT64:
+                    node->init_type<PrimitiveType::FLOAT64>();
+                    break;
+                case PrimitiveType::STRING:
+                // (the values of an enum are strings in JSON)
+                case PrimitiveType::ENUM:
+                    node->init_type<PrimitiveType::STRING>();
+                    break;
+                default:
+                    throw std::invalid_argument("Unsupported primitive type in JSON schema");
+            }
+            return std::move(node);
+        }
+        default:
+            return make_unique<IncompleteNode>();
+    }
+}
+
+static unique_ptr<Node> root_node(const Node* schema) {
+    if (schema) {
+        return empty_copy(*schema);
+    }
+    return make_unique<IncompleteNode>();
+}
+
+// a named type of an Avro schema (a record or enum), with the namespace of its definition, which
+// is null while the type is being defined (as recursive types cannot be represented)
+struct AvroName {
+    const json::json* definition;
+    string space;
+};
+
+// the named types of an Avro schema by their full names
+typedef map<string, AvroName> AvroNames;
+
+static unique_ptr<Node> avro_node(const json::json& schema, const string& space, AvroNames& names);
+
+static unique_ptr<Node> avro_named(const json::json& definition, const string& space,
+                                   AvroNames& names);
+
+static unique_ptr<Node> avro_primitive(const string& name, const string& space,
+                                       AvroNames& names) {
+    unique_ptr<PrimitiveNode> node = make_unique<PrimitiveNode>();
+    if (name == "null") {
+        return make_unique<IncompleteNode>();
+    } else if (name == "boolean") {
+        node->init_type<PrimitiveType::BOOL>();
+    } else if (name == "int") {
+        node->init_type<PrimitiveType::INT32>();
+    } else if (name == "long") {
+        node->init_type<PrimitiveType::INT64>();
+    } else if (name == "float") {
+        node->init_type<PrimitiveType::FLOAT32>();
+    } else if (name == "double") {
+        node->init_type<PrimitiveType::FLOAT64>();
+    } else if (name == "string") {
+        node->init_type<PrimitiveType::STRING>();
+    } else if (name == "bytes") {
+        throw std::invalid_argument("Avro bytes are not supported in JSON schemas");
+    } else {
+        // a reference to a named type
+        auto named = names.find(name.find('.') == string::npos && !space.empty()
+                                    ? space + "." + name
+                                    : name);
+        if (named == names.end()) {
+            named = names.find(name);
+        }
+        if (named == names.end()) {
+            throw std::invalid_argument("Unknown Avro type " + name);
+        }
+        if (!named->second.definition) {
+            throw std::invalid_argument("Recursive Avro type " + name + " is not supported");
+        }
+        return avro_named(*named->second.definition, named->second.space, names);
+    }
+    return std::move(node);
+}
+
+static unique_ptr<Node> avro_node(const json::json& schema, const string& space, AvroNames& names) {
+    if (schema.is_string()) {
+        return avro_primitive(schema.get<string>(), space, names);
+    }
+    if (schema.is_array()) {
+        // a union, which (as every node is nullable) may only add null to another type
+        const json::json* branch = nullptr;
+        for (const json::json& option : schema) {
+            if (option.is_string() && option.get<string>() == "null") {
+                continue;
+            }
+            if (branch) {
+                throw std::invalid_argument("Avro unions of more than one type are not supported");
+            }
+            branch = &option;
+        }
+        return branch ? avro_node(*branch, space, names) : make_unique<IncompleteNode>();
+    }
+    if (!schema.is_object() || !schema.contains("type")) {
+        throw std::invalid_argument("Invalid Avro schema");
+    }
+
+    const json::json& type = schema.at("type");
+    if (!type.is_string()) {
+        return avro_node(type, space, names);
+    }
+    const string& type_name = type.get_ref<const string&>();
+    if (type_name == "array") {
+        unique_ptr<ListNode> node = make_unique<ListNode>();
+        node->get_list() = avro_node(schema.at("items"), space, names);
+        return std::move(node);
+    } else if (type_name == "map" || type_name == "fixed") {
+        throw std::invalid_argument("Avro " + type_name + "s are not supported in JSON schemas");
+    } else if (type_name != "record" && type_name != "error" && type_name != "enum") {
+        // a primitive (perhaps with a logical type, which is not used)
+        return avro_primitive(type_name, space, names);
+    }
+
+    string name = schema.at("name").get<string>();
+    string name_space = schema.contains("namespace") ? schema.at("namespace").get<string>() : space;
+    if (name.find('.') != string::npos) {
+        name_space = name.substr(0, name.rfind('.'));
+    } else if (!name_space.empty()) {
+        name = name_space + "." + name;
+    }
+    if (names.count(name)) {
+        throw std::invalid_argument("Avro type " + name + " is defined more than once");
+    }
+    names[name] = {nullptr, name_space};
+    unique_ptr<Node> node = avro_named(schema, name_space, names);
+    names[name].definition = &schema;
     return node;
 }
 
-ObjType JsonConverter::type(json::json& datum) {
-    switch (datum.type()) {
-        case value_t::null:
-            return ObjType::INCOMPLETE;
-        case value_t::array:
-            return ObjType::LIST;
-        case value_t::object:
-            return ObjType::RECORD;
-        case value_t::discarded:
-            throw std::runtime_error("Not sure how to handle discarded symbols");
+static unique_ptr<Node> avro_named(const json::json& definition, const string& space,
+                                   AvroNames& names) {
+    if (definition.at("type") == "enum") {
+        unique_ptr<PrimitiveNode> node = make_unique<PrimitiveNode>();
+        node->init_type<PrimitiveType::STRING>();
+        return std::move(node);
+    }
+    unique_ptr<RecordNode> node = make_unique<RecordNode>();
+    for (const json::json& field : definition.at("fields")) {
+        node->get_field(field.at("name").get<string>()) = avro_node(field.at("type"), space, names);
+    }
+    return std::move(node);
+}
+
+unique_ptr<Node> schema_from_avro(const std::string& avro_schema) {
+    json::json schema;
+    try {
+        schema = json::json::parse(avro_schema);
+    } catch (json::json::exception& e) {
+        throw std::invalid_argument(string("Invalid Avro schema: ") + e.what());
+    }
+    AvroNames names;
+    try {
+        return avro_node(schema, "", names);
+    } catch (json::json::exception& e) {
+        throw std::invalid_argument(string("Invalid Avro schema: ") + e.what());
+    }
+}
+
+unique_ptr<Node> convert(std::istream& is, const ColumnFilter* column_filter, const Node* schema,
+                         size_t expected_rows) {
+    unique_ptr<Node> node = root_node(schema);
+    JsonHandler handler(node, column_filter, expected_rows);
+    json::json::sax_parse(is, &handler);
+    return node;
+}
+
+// the document is parsed directly from memory (without going through a stream)
+unique_ptr<Node> convert(const char* data, size_t size, const ColumnFilter* column_filter,
+                         const Node* schema, size_t expected_rows) {
+    unique_ptr<Node> node = root_node(schema);
+    JsonHandler handler(node, column_filter, expected_rows);
+    JsonParser(handler).parse(data, data + size);
+    return node;
+}
+
+static bool is_blank(const char* begin, const char* end) {
+    return std::all_of(begin, end, [](char c) { return c == ' ' || c == '\t' || c == '\r'; });
+}
+
+// parses each (non-blank) line of [begin, end) as an entry of the list under node, returning the
+// number of entries
+static size_t convert_lines(const char* begin, const char* end, unique_ptr<Node>& node,
+                            const ColumnFilter* column_filter) {
+    JsonHandler handler(node, column_filter);
+    JsonParser parser(handler);
+    size_t count = 0;
+    while (begin < end) {
+        const char* line_end = static_cast<const char*>(std::memchr(begin, '\n', end - begin));
+        if (!line_end) {
+            line_end = end;
+        }
+        if (!is_blank(begin, line_end)) {
+            parser.parse(begin, line_end);
+            count++;
+        }
+        begin = line_end + 1;
+    }
+    return count;
+}
+
+static unique_ptr<Node> lines_node(unique_ptr<Node>&& list, size_t count) {
+    unique_ptr<ListNode> node = make_unique<ListNode>();
+    node->get_list() = std::move(list);
+    node->add_list(count);
+    node->add_not_null();
+    return std::move(node);
+}
+
+// a range of whole lines, parsed by one thread into its own node tree
+struct LineShard {
+    const char* begin;
+    const char* end;
+    // a hint for the number of lines in the range
+    size_t expected_rows;
+    size_t count = 0;
+    unique_ptr<Node> node;
+
+    LineShard(const char* begin, const char* end, size_t expected_rows)
+        : begin(begin), end(end), expected_rows(expected_rows) {}
+
+    void convert(const ColumnFilter* column_filter, const Node* schema) {
+        node = root_node(schema);
+        node->reserve(expected_rows);
+        count = convert_lines(begin, end, node, column_filter);
+    }
+};
+
+unique_ptr<Node> convert_lines(const char* data, size_t size, const ColumnFilter* column_filter,
+                               const Node* schema, size_t expected_rows, size_t threads) {
+    threads = thread_count(threads);
+
+    // the input is split into (at most) one range of similar size per thread, at line boundaries
+    const char* end = data + size;
+    vector<LineShard> shards;
+    const char* begin = data;
+    for (size_t i = 1; i <= threads && begin < end; i++) {
+        const char* split = i == threads ? end : data + size * i / threads;
+        if (split < begin) {
+            continue;
+        }
+        split = static_cast<const char*>(std::memchr(split, '\n', end - split));
+        split = split ? split + 1 : end;
+        // (the expected lines are shared out in proportion to the size of the ranges)
+        shards.emplace_back(begin, split,
+                            static_cast<size_t>(double(expected_rows) * (split - begin) / size));
+        begin = split;
+    }
+
+    parallel_for(shards.size(), [&](size_t i) { shards[i].convert(column_filter, schema); });
+
+    // fields first seen in a later range are filled with nulls for the entries of the earlier ones
+    unique_ptr<Node> list = root_node(schema);
+    size_t count = 0;
+    for (LineShard& shard : shards) {
+        concat(list, *shard.node);
+        count += shard.count;
+    }
+    return lines_node(std::move(list), count);
+}
+
+unique_ptr<Node> convert_lines(std::istream& is, const ColumnFilter* column_filter,
+                               const Node* schema, size_t expected_rows, size_t threads) {
+    if (threads == 1) {
+        // the lines are parsed as they are read
+        unique_ptr<Node> list = root_node(schema);
+        list->reserve(expected_rows);
+        JsonHandler handler(list, column_filter);
+        JsonParser parser(handler);
+        size_t count = 0;
+        std::string line;
+        while (std::getline(is, line)) {
+            if (!is_blank(line.data(), line.data() + line.size())) {
+                parser.parse(line.data(), line.data() + line.size());
+                count++;
+            }
+        }
+        return lines_node(std::move(list), count);
+    }
+
+    // the whole stream is read into memory to split it between the threads
+    std::string data(std::istreambuf_iterator<char>(is), {});
+    return convert_lines(data.data(), data.size(), column_filter, schema, expected_rows, threads);
+}
+
+// the children of a node only hold entries for its non-null entries
+static size_t not_null_count(Node& node) {
+    return node.get_size() - node.get_null_count();
+}
+
+static void fill_nulls(Node& node, size_t size) {
+    while (node.get_size() < size) {
+        node.add_null();
+    }
+}
+
+bool JsonHandler::skipped(bool starts_container) {
+    if (skip_depth > 0) {
+        skip_depth += starts_container;
+        return true;
+    }
+    if (skip_value) {
+        skip_value = false;
+        skip_depth = starts_container;
+        return true;
+    }
+    return false;
+}
+
+const ColumnFilter* JsonHandler::value_filter(bool& value_implicit_include) const {
+    if (frames.empty()) {
+        value_implicit_include = implicit_include;
+        return column_filter;
+    }
+    const Frame& frame = frames.back();
+    if (frame.node->type == ObjType::LIST) {
+        // the entries of a list have the list's filter
+        value_implicit_include = frame.implicit_include;
+        return frame.column_filter;
+    }
+    value_implicit_include = frame.field_implicit_include;
+    return frame.field_filter;
+}
+
+Node& JsonHandler::target(ObjType type) {
+    unique_ptr<Node>* node = &root;
+    if (!frames.empty()) {
+        Frame& frame = frames.back();
+        if (frame.node->type == ObjType::LIST) {
+            node = &static_cast<ListNode*>(frame.node)->get_list();
+        } else {
+            node = frame.field;
+        }
+    }
+
+    if ((*node)->type == ObjType::INCOMPLETE) {
+        init(*node, type);
+    }
+    if ((*node)->type != type && type != ObjType::INCOMPLETE) {
+        throw std::invalid_argument("Inconsistent schema");
+    }
+    return **node;
+}
+
+void JsonHandler::added() {
+    if (!frames.empty() && frames.back().node->type == ObjType::LIST) {
+        frames.back().count++;
+    }
+}
+
+bool JsonHandler::null() {
+    bool value_implicit_include;
+    const ColumnFilter* filter = value_filter(value_implicit_include);
+    if (skipped(false) || !ColumnFilter::included(filter, value_implicit_include)) {
+        return true;
+    }
+    target(ObjType::INCOMPLETE).add_null();
+    added();
+    return true;
+}
+
+template <class R> static bool fits(uint64_t value) {
+    return value <= static_cast<uint64_t>(std::numeric_limits<R>::max());
+}
+
+template <class R> static bool fits(int64_t value) {
+    if (value >= 0) {
+        return fits<R>(static_cast<uint64_t>(value));
+    }
+    return std::is_signed<R>::value && value >= static_cast<int64_t>(std::numeric_limits<R>::min());
+}
+
+template <PrimitiveType PT, class T> static void add_integer(PrimitiveNode& node, T value) {
+    typedef typename VectorTyper<PT>::vector_type::value_type R;
+    if (!fits<R>(value)) {
+        throw std::invalid_argument("Integer " + std::to_string(value) + " out of range of column");
+    }
+    node.add_by_type<PT>(static_cast<R>(value));
+}
+
+template <class T> static void add_number(PrimitiveNode& node, T value) {
+    switch (node.get_type()) {
+        case PrimitiveType::INT8:
+            add_integer<PrimitiveType::INT8>(node, value);
+            break;
+        case PrimitiveType::INT16:
+            add_integer<PrimitiveType::INT16>(node, value);
+            break;
+        case PrimitiveType::INT32:
+            add_integer<PrimitiveType::INT32>(node, value);
+            break;
+        case PrimitiveType::INT64:
+            add_integer<PrimitiveType::INT64>(node, value);
+            break;
+        case PrimitiveType::UINT8:
+            add_integer<PrimitiveType::UINT8>(node, value);
+            break;
+        case PrimitiveType::UINT16:
+            add_integer<PrimitiveType::UINT16>(node, value);
+            break;
+        case PrimitiveType::UINT32:
+            add_integer<PrimitiveType::UINT32>(node, value);
+            break;
+        case PrimitiveType::UINT64:
+            add_integer<PrimitiveType::UINT64>(node, value);
+            break;
+        case PrimitiveType::FLOAT32:
+            node.add_by_type<PrimitiveType::FLOAT32>(static_cast<float>(value));
+            break;
+        case PrimitiveType::FLOAT64:
+            node.add_by_type<PrimitiveType::FLOAT64>(static_cast<double>(value));
+            break;
         default:
-            return ObjType::PRIMITIVE;
+            // typed by the value (if it is the first), or a mismatch
+            node.add(value);
     }
 }
 
-FieldIterator JsonConverter::fields(json::json& datum) {
-    return FieldIterator(datum);
+void JsonHandler::add_value(PrimitiveNode& node, bool value) {
+    node.add(value);
 }
 
-ListIterator JsonConverter::get_list(json::json& datum) {
-    return ListIterator(datum);
+void JsonHandler::add_value(PrimitiveNode& node, int64_t value) {
+    add_number(node, value);
 }
 
-void JsonConverter::add_primitive(PrimitiveNode& v, json::json& datum) {
-    switch (datum.type()) {
-        case value_t::string:
-            v.add(datum.get<std::string>());
-            return;
-        case value_t::boolean:
-            v.add(datum.get<bool>());
-            return;
-        case value_t::number_unsigned:
-            v.add(datum.get<uint64_t>());
-            return;
-        case value_t::number_integer:
-            v.add(datum.get<int64_t>());
-            return;
-        case value_t::number_float:
-            v.add(datum.get<double>());
-            return;
+void JsonHandler::add_value(PrimitiveNode& node, uint64_t value) {
+    add_number(node, value);
+}
+
+void JsonHandler::add_value(PrimitiveNode& node, double value) {
+    switch (node.get_type()) {
+        case PrimitiveType::FLOAT32:
+            node.add_by_type<PrimitiveType::FLOAT32>(static_cast<float>(value));
+            break;
         default:
-            throw std::runtime_error("Unexpected primitive type");
+            node.add(value);
+    }
+}
+
+template <PrimitiveType PT, class T> static void add_float(PrimitiveNode& node, T value) {
+    typedef typename VectorTyper<PT>::vector_type::value_type R;
+    node.add_by_type<PT>(static_cast<R>(value));
+}
+
+// (a value of another kind can not be added, and this throws as the node is already typed)
+template <class T> static void add_mismatched(PrimitiveNode& node, T value) {
+    node.add(value);
+}
+
+template <PrimitiveType PT> static const PrimitiveAppender* integer_appender() {
+    static const PrimitiveAppender appender = {add_mismatched<bool>, add_integer<PT, int64_t>,
+                                               add_integer<PT, uint64_t>, add_mismatched<double>};
+    return &appender;
+}
+
+template <PrimitiveType PT> static const PrimitiveAppender* float_appender() {
+    static const PrimitiveAppender appender = {add_mismatched<bool>, add_float<PT, int64_t>,
+                                               add_float<PT, uint64_t>, add_float<PT, double>};
+    return &appender;
+}
+
+static void add_boolean(PrimitiveNode& node, bool value) {
+    node.add_by_type<PrimitiveType::BOOL>(value);
+}
+
+const PrimitiveAppender* PrimitiveAppender::get(PrimitiveType type) {
+    static const PrimitiveAppender bool_appender = {
+        add_boolean, add_mismatched<int64_t>, add_mismatched<uint64_t>, add_mismatched<double>};
+    switch (type) {
+        case PrimitiveType::BOOL:
+            return &bool_appender;
+        case PrimitiveType::INT8:
+            return integer_appender<PrimitiveType::INT8>();
+        case PrimitiveType::INT16:
+            return integer_appender<PrimitiveType::INT16>();
+        case PrimitiveType::INT32:
+            return integer_appender<PrimitiveType::INT32>();
+        case PrimitiveType::INT64:
+            return integer_appender<PrimitiveType::INT64>();
+        case PrimitiveType::UINT8:
+            return integer_appender<PrimitiveType::UINT8>();
+        case PrimitiveType::UINT16:
+            return integer_appender<PrimitiveType::UINT16>();
+        case PrimitiveType::UINT32:
+            return integer_appender<PrimitiveType::UINT32>();
+        case PrimitiveType::UINT64:
+            return integer_appender<PrimitiveType::UINT64>();
+        case PrimitiveType::FLOAT32:
+            return float_appender<PrimitiveType::FLOAT32>();
+        case PrimitiveType::FLOAT64:
+            return float_appender<PrimitiveType::FLOAT64>();
+        default:
+            return nullptr;
+    }
+}
+
+void JsonHandler::bind(Frame& frame, Node& node) {
+    frame.primitive = nullptr;
+    frame.appender = nullptr;
+    if (node.type == ObjType::PRIMITIVE) {
+        PrimitiveNode& primitive = static_cast<PrimitiveNode&>(node);
+        frame.appender = PrimitiveAppender::get(primitive.get_type());
+        if (frame.appender) {
+            frame.primitive = &primitive;
+        }
+    }
+}
+
+bool JsonHandler::string(const char* data, size_t size) {
+    bool value_implicit_include;
+    const ColumnFilter* filter = value_filter(value_implicit_include);
+    if (skipped(false) || !ColumnFilter::included(filter, value_implicit_include)) {
+        return true;
+    }
+    PrimitiveNode& node = static_cast<PrimitiveNode&>(target(ObjType::PRIMITIVE));
+    PrimitiveType type = node.get_type();
+    if (type != PrimitiveType::EMPTY && type != PrimitiveType::STRING) {
+        throw std::invalid_argument("Mismatched primitive types");
+    }
+    node.add_string(data, size);
+    node.add_not_null();
+    added();
+    return true;
+}
+
+bool JsonHandler::start_object(size_t) {
+    if (skipped(true)) {
+        return true;
+    }
+    bool value_implicit_include;
+    const ColumnFilter* filter = value_filter(value_implicit_include);
+    Node& node = target(ObjType::RECORD);
+    // (the fields of an object are included by default if the object is)
+    frames.push_back({&node, not_null_count(node), filter,
+                      ColumnFilter::included(filter, value_implicit_include)});
+    return true;
+}
+
+bool JsonHandler::key(std::string& name) {
+    if (skip_depth > 0) {
+        return true;
+    }
+    Frame& frame = frames.back();
+    frame.field_filter = ColumnFilter::child(frame.column_filter, name);
+    frame.field_implicit_include = frame.implicit_include;
+    // nothing under a member can be included if it is not, and none of its fields are explicitly
+    bool included = ColumnFilter::included(frame.field_filter, frame.field_implicit_include) ||
+                    (frame.field_filter && frame.field_filter->has_includes());
+    if (!included) {
+        skip_value = true;
+        return true;
+    }
+
+    unique_ptr<Node>& field = static_cast<RecordNode*>(frame.node)->get_field(name);
+    // a field that has not been seen before is null for the record's existing entries
+    fill_nulls(*field, frame.count);
+    if (field->get_size() > frame.count) {
+        // the last of a repeated member wins (as it would in a document tree), so its earlier value
+        // is dropped
+        truncate(*field, frame.count);
+    }
+    frame.field = &field;
+    bind(frame, *field);
+    return true;
+}
+
+bool JsonHandler::end_object() {
+    if (skip_depth > 0) {
+        skip_depth--;
+        return true;
+    }
+    RecordNode& node = *static_cast<RecordNode*>(frames.back().node);
+    frames.pop_back();
+    node.add_not_null();
+    // the fields that were missing from the object are null for it
+    size_t entries = not_null_count(node);
+    for (size_t i = 0; i < node.get_field_count(); i++) {
+        fill_nulls(*node.get_field(i), entries);
+    }
+    added();
+    return true;
+}
+
+bool JsonHandler::start_array(size_t) {
+    if (skipped(true)) {
+        return true;
+    }
+    bool value_implicit_include;
+    const ColumnFilter* filter = value_filter(value_implicit_include);
+    ListNode& node = static_cast<ListNode&>(target(ObjType::LIST));
+    if (frames.empty() && expected_rows) {
+        node.get_list()->reserve(expected_rows);
+    }
+    frames.push_back({&node, 0, filter, value_implicit_include});
+    bind(frames.back(), *node.get_list());
+    return true;
+}
+
+bool JsonHandler::end_array() {
+    if (skip_depth > 0) {
+        skip_depth--;
+        return true;
     }
+    Frame frame = frames.back();
+    frames.pop_back();
+    ListNode& node = *static_cast<ListNode*>(frame.node);
+    node.add_list(frame.count);
+    node.add_not_null();
+    added();
+    return true;
 }
 
 }  // namespace json
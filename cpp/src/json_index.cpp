@@ -0,0 +1,310 @@
+// Copyright (c) 2019 Michael Vilim
+//
+// This file is part of the bamboo library. It is currently hosted at
+// https://github.com/mvilim/bamboo
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <json_index.hpp>
+#include <stdexcept>
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define BAMBOO_JSON_X86
+#include <immintrin.h>
+#elif defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace bamboo {
+namespace json {
+
+static constexpr size_t block_size = 64;
+
+// the number of bytes indexed at a time (a multiple of the block size)
+static constexpr size_t window_size = 16 * 1024;
+
+// the bytes of a block that are of interest, with a bit for each byte
+struct BlockMasks {
+    uint64_t quote = 0;
+    uint64_t backslash = 0;
+    // brackets, colons and commas
+    uint64_t op = 0;
+    uint64_t whitespace = 0;
+    // bytes below 0x20
+    uint64_t control = 0;
+};
+
+static void classify_scalar(const char* block, BlockMasks& masks) {
+    for (size_t i = 0; i < block_size; i++) {
+        uint64_t bit = uint64_t(1) << i;
+        unsigned char c = block[i];
+        switch (c) {
+            case '"':
+                masks.quote |= bit;
+                break;
+            case '\\':
+                masks.backslash |= bit;
+                break;
+            case '{':
+            case '}':
+            case '[':
+            case ']':
+            case ':':
+            case ',':
+                masks.op |= bit;
+                break;
+            case ' ':
+            case '\t':
+            case '\n':
+            case '\r':
+                masks.whitespace |= bit;
+                break;
+        }
+        if (c < 0x20) {
+            masks.control |= bit;
+        }
+    }
+}
+
+#ifdef BAMBOO_JSON_X86
+__attribute__((target("sse4.2"))) static void classify_sse42(const char* block,
+                                                             BlockMasks& masks) {
+    const __m128i ops = _mm_setr_epi8('{', '}', '[', ']', ':', ',', 0, 0, 0, 0, 0, 0, 0, 0, 0, 0);
+    const __m128i spaces = _mm_setr_epi8(' ', '\t', '\n', '\r', 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0);
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i backslash = _mm_set1_epi8('\\');
+    const __m128i last_control = _mm_set1_epi8(0x1F);
+    const int mode = _SIDD_UBYTE_OPS | _SIDD_CMP_EQUAL_ANY | _SIDD_BIT_MASK;
+    for (size_t i = 0; i < block_size; i += 16) {
+        __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(block + i));
+        // (the explicit length comparisons, as the input may hold zero bytes)
+        masks.op |= uint64_t(_mm_cvtsi128_si32(_mm_cmpestrm(ops, 6, chunk, 16, mode))) << i;
+        masks.whitespace |= uint64_t(_mm_cvtsi128_si32(_mm_cmpestrm(spaces, 4, chunk, 16, mode)))
+                            << i;
+        masks.quote |= uint64_t(_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, quote))) << i;
+        masks.backslash |= uint64_t(_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, backslash))) << i;
+        __m128i control = _mm_cmpeq_epi8(_mm_min_epu8(chunk, last_control), chunk);
+        masks.control |= uint64_t(_mm_movemask_epi8(control)) << i;
+    }
+}
+
+__attribute__((target("avx2"))) static void classify_avx2(const char* block, BlockMasks& masks) {
+    const __m256i lower = _mm256_set1_epi8(0x20);
+    const __m256i open = _mm256_set1_epi8('{');
+    const __m256i close = _mm256_set1_epi8('}');
+    const __m256i colon = _mm256_set1_epi8(':');
+    const __m256i comma = _mm256_set1_epi8(',');
+    const __m256i space = _mm256_set1_epi8(' ');
+    const __m256i tab = _mm256_set1_epi8('\t');
+    const __m256i newline = _mm256_set1_epi8('\n');
+    const __m256i carriage_return = _mm256_set1_epi8('\r');
+    const __m256i quote = _mm256_set1_epi8('"');
+    const __m256i backslash = _mm256_set1_epi8('\\');
+    const __m256i last_control = _mm256_set1_epi8(0x1F);
+    for (size_t i = 0; i < block_size; i += 32) {
+        __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(block + i));
+        // setting the 0x20 bit maps '[' and ']' onto '{' and '}' (and nothing else onto them)
+        __m256i folded = _mm256_or_si256(chunk, lower);
+        __m256i op = _mm256_or_si256(
+            _mm256_or_si256(_mm256_cmpeq_epi8(folded, open), _mm256_cmpeq_epi8(folded, close)),
+            _mm256_or_si256(_mm256_cmpeq_epi8(chunk, colon), _mm256_cmpeq_epi8(chunk, comma)));
+        __m256i whitespace = _mm256_or_si256(
+            _mm256_or_si256(_mm256_cmpeq_epi8(chunk, space), _mm256_cmpeq_epi8(chunk, tab)),
+            _mm256_or_si256(_mm256_cmpeq_epi8(chunk, newline),
+                            _mm256_cmpeq_epi8(chunk, carriage_return)));
+        __m256i control = _mm256_cmpeq_epi8(_mm256_min_epu8(chunk, last_control), chunk);
+        masks.op |= uint64_t(uint32_t(_mm256_movemask_epi8(op))) << i;
+        masks.whitespace |= uint64_t(uint32_t(_mm256_movemask_epi8(whitespace))) << i;
+        masks.quote |= uint64_t(uint32_t(_mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, quote))))
+                       << i;
+        masks.backslash |=
+            uint64_t(uint32_t(_mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, backslash)))) << i;
+        masks.control |= uint64_t(uint32_t(_mm256_movemask_epi8(control))) << i;
+    }
+}
+#endif
+
+typedef void (*Classifier)(const char* block, BlockMasks& masks);
+
+struct NamedClassifier {
+    const char* name;
+    Classifier classify;
+};
+
+// the fastest first
+static vector<NamedClassifier> supported_classifiers() {
+    vector<NamedClassifier> supported;
+#ifdef BAMBOO_JSON_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        supported.push_back({"avx2", classify_avx2});
+    }
+    if (__builtin_cpu_supports("sse4.2")) {
+        supported.push_back({"sse4.2", classify_sse42});
+    }
+#endif
+    supported.push_back({"scalar", classify_scalar});
+    return supported;
+}
+
+static const vector<NamedClassifier>& named_classifiers() {
+    static const vector<NamedClassifier> supported = supported_classifiers();
+    return supported;
+}
+
+static const NamedClassifier* find_classifier(const string& name) {
+    for (const NamedClassifier& classifier : named_classifiers()) {
+        if (name == classifier.name) {
+            return &classifier;
+        }
+    }
+    return nullptr;
+}
+
+static const NamedClassifier* select_classifier() {
+    const char* name = std::getenv("BAMBOO_JSON_CLASSIFIER");
+    const NamedClassifier* selected = name ? find_classifier(name) : nullptr;
+    return selected ? selected : &named_classifiers().front();
+}
+
+// chosen once, for the processor the library is loaded on (unless it is set for testing)
+static std::atomic<const NamedClassifier*> current_classifier{select_classifier()};
+
+vector<string> classifiers() {
+    vector<string> names;
+    for (const NamedClassifier& classifier : named_classifiers()) {
+        names.push_back(classifier.name);
+    }
+    return names;
+}
+
+string get_classifier() {
+    return current_classifier.load()->name;
+}
+
+void set_classifier(const string& name) {
+    const NamedClassifier* classifier = find_classifier(name);
+    if (!classifier) {
+        throw std::invalid_argument("Unsupported JSON classifier " + name);
+    }
+    current_classifier.store(classifier);
+}
+
+static size_t trailing_zeros(uint64_t bits) {
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_ctzll(bits);
+#elif defined(_MSC_VER) && defined(_M_X64)
+    unsigned long index;
+    _BitScanForward64(&index, bits);
+    return index;
+#else
+    size_t count = 0;
+    for (; !(bits & 1); bits >>= 1) {
+        count++;
+    }
+    return count;
+#endif
+}
+
+// each bit is set to the parity of the bits up to (and including) it
+static uint64_t prefix_xor(uint64_t bits) {
+    bits ^= bits << 1;
+    bits ^= bits << 2;
+    bits ^= bits << 4;
+    bits ^= bits << 8;
+    bits ^= bits << 16;
+    bits ^= bits << 32;
+    return bits;
+}
+
+// the characters escaped by a backslash: those after an odd length run of backslashes (escaped
+// carries whether the first character of the next block is); the runs are split into those
+// starting on even and odd bits, which an addition carries to their ends
+static uint64_t find_escaped(uint64_t backslash, uint64_t& escaped) {
+    if (!backslash) {
+        uint64_t result = escaped;
+        escaped = 0;
+        return result;
+    }
+    // an escaped backslash does not escape the character after it
+    backslash &= ~escaped;
+    uint64_t follows_escape = backslash << 1 | escaped;
+    const uint64_t even_bits = 0x5555555555555555ULL;
+    uint64_t odd_starts = backslash & ~even_bits & ~follows_escape;
+    // (the runs starting on odd bits are cleared, leaving a bit at their ends)
+    uint64_t even_runs = odd_starts + backslash;
+    escaped = even_runs < backslash;
+    return (even_bits ^ (even_runs << 1)) & follows_escape;
+}
+
+void StructuralIndexer::reset(const char* begin, const char* end) {
+    pos = begin;
+    this->end = end;
+    escaped = 0;
+    in_string = 0;
+    in_scalar = 0;
+    control = nullptr;
+    classify = current_classifier.load()->classify;
+}
+
+void StructuralIndexer::index_block(const char* block, const char* base,
+                                    vector<const char*>& positions) {
+    BlockMasks masks;
+    classify(block, masks);
+
+    uint64_t quote = masks.quote & ~find_escaped(masks.backslash, escaped);
+    // the characters from each opening quote up to (but not including) its closing quote
+    uint64_t string = prefix_xor(quote) ^ in_string;
+    in_string = static_cast<uint64_t>(static_cast<int64_t>(string) >> 63);
+    uint64_t string_control = masks.control & string;
+    if (string_control && !control) {
+        control = base + trailing_zeros(string_control);
+    }
+
+    uint64_t op = masks.op & ~string;
+    uint64_t scalar = ~(masks.op | masks.whitespace | quote | string);
+    uint64_t scalar_start = scalar & ~(scalar << 1 | in_scalar);
+    in_scalar = scalar >> 63;
+
+    for (uint64_t structural = op | quote | scalar_start; structural;
+         structural &= structural - 1) {
+        positions.push_back(base + trailing_zeros(structural));
+    }
+}
+
+bool StructuralIndexer::next(vector<const char*>& positions) {
+    positions.clear();
+    if (pos == end) {
+        return false;
+    }
+    const char* window_end = pos + std::min<size_t>(end - pos, window_size);
+    for (; static_cast<size_t>(window_end - pos) >= block_size; pos += block_size) {
+        index_block(pos, pos, positions);
+    }
+    if (pos < window_end) {
+        // the end of the input is padded with whitespace
+        char block[block_size];
+        std::memset(block, ' ', block_size);
+        std::memcpy(block, pos, window_end - pos);
+        index_block(block, pos, positions);
+        pos = window_end;
+    }
+    return true;
+}
+
+}  // namespace json
+}  // namespace bamboo
@@ -0,0 +1,616 @@
+// Copyright (c) 2019 Michael Vilim
+//
+// This file is part of the bamboo library. It is currently hosted at
+// https://github.com/mvilim/bamboo
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <parquet.hpp>
+
+#include <parquet/api/reader.h>
+#include <cstring>
+#include <functional>
+
+namespace bamboo {
+namespace parquet {
+
+using ::parquet::ColumnDescriptor;
+using ::parquet::ColumnReader;
+using ::parquet::ConvertedType;
+using ::parquet::LogicalType;
+using ::parquet::ParquetFileReader;
+using ::parquet::SchemaDescriptor;
+using ::parquet::Type;
+namespace schema = ::parquet::schema;
+
+// A node of the tree that the (filtered) Parquet schema maps to. Each level of a leaf below the
+// node with a definition level of at least present_level is part of an entry of the node: a new
+// entry if its repetition level is at most enclosing_repetition (i.e. it starts a new element of
+// the enclosing list, or a new row), otherwise the current one. The entry is null unless the
+// definition level is at least defined_level.
+struct PlanNode {
+    ObjType type;
+    // the field name (within the parent record)
+    string name;
+    int16_t present_level;
+    int16_t defined_level;
+    int16_t enclosing_repetition;
+    // for lists, the definition level at which an entry has an element, and the repetition level
+    // of the elements (a level with a repetition level of at most this starts a new element)
+    int16_t element_level = 0;
+    int16_t repetition_level = 0;
+    vector<unique_ptr<PlanNode>> children;
+    // for primitives, the leaf column
+    int column = -1;
+    // every leaf below a node repeats the node's levels, so the entries of the node are only added
+    // while reading the first (included) leaf below it
+    int driver = -1;
+};
+
+static const schema::GroupNode& group(const schema::Node& node) {
+    return static_cast<const schema::GroupNode&>(node);
+}
+
+// a (three level) LIST or MAP annotated group, i.e. a list whose elements are its repeated child
+static bool is_list(const schema::Node& node) {
+    if (!node.is_group() || group(node).field_count() != 1) {
+        return false;
+    }
+    if (!group(node).field(0)->is_repeated()) {
+        return false;
+    }
+    const std::shared_ptr<const LogicalType>& logical = node.logical_type();
+    return (logical && (logical->is_list() || logical->is_map())) ||
+           node.converted_type() == ConvertedType::LIST ||
+           node.converted_type() == ConvertedType::MAP ||
+           node.converted_type() == ConvertedType::MAP_KEY_VALUE;
+}
+
+// whether the single field of the repeated child of a list is the element (rather than the
+// repeated child itself, as in e.g. the legacy two level lists and maps)
+static bool has_element_field(const schema::Node& list, const schema::Node& repeated) {
+    bool is_map = (list.logical_type() && list.logical_type()->is_map()) ||
+                  list.converted_type() == ConvertedType::MAP ||
+                  list.converted_type() == ConvertedType::MAP_KEY_VALUE;
+    return !is_map && repeated.is_group() && group(repeated).field_count() == 1 &&
+           repeated.name() != "array" && repeated.name() != list.name() + "_tuple";
+}
+
+static unique_ptr<PlanNode> plan_field(const schema::Node& field, int16_t definition,
+                                       int16_t repetition, const SchemaDescriptor& schema,
+                                       const ColumnFilter* column_filter, bool implicit_include);
+
+// plans a value with an entry wherever the definition level is at least present (which is not null
+// once it is at least defined), returning null if none of its leaves pass the filter
+static unique_ptr<PlanNode> plan_value(const schema::Node& node, int16_t present, int16_t defined,
+                                       int16_t repetition, const SchemaDescriptor& schema,
+                                       const ColumnFilter* column_filter, bool implicit_include) {
+    unique_ptr<PlanNode> plan = make_unique<PlanNode>();
+    plan->name = node.name();
+    plan->present_level = present;
+    plan->defined_level = defined;
+    plan->enclosing_repetition = repetition;
+    if (is_list(node)) {
+        plan->type = ObjType::LIST;
+        plan->element_level = defined + 1;
+        plan->repetition_level = repetition + 1;
+        const schema::Node& repeated = *group(node).field(0);
+        // lists are transparent to the filters
+        unique_ptr<PlanNode> element =
+            has_element_field(node, repeated)
+                ? plan_field(*group(repeated).field(0), defined + 1, repetition + 1, schema,
+                             column_filter, implicit_include)
+                : plan_value(repeated, defined + 1, defined + 1, repetition + 1, schema,
+                             column_filter, implicit_include);
+        if (!element) {
+            return nullptr;
+        }
+        plan->children.push_back(std::move(element));
+    } else if (node.is_group()) {
+        plan->type = ObjType::RECORD;
+        bool included = ColumnFilter::included(column_filter, implicit_include);
+        for (int i = 0; i < group(node).field_count(); i++) {
+            const schema::Node& field = *group(node).field(i);
+            unique_ptr<PlanNode> child =
+                plan_field(field, defined, repetition, schema,
+                           ColumnFilter::child(column_filter, field.name()), included);
+            if (child) {
+                plan->children.push_back(std::move(child));
+            }
+        }
+        if (plan->children.empty()) {
+            return nullptr;
+        }
+    } else {
+        if (!ColumnFilter::included(column_filter, implicit_include)) {
+            return nullptr;
+        }
+        plan->type = ObjType::PRIMITIVE;
+        plan->column = schema.ColumnIndex(node);
+    }
+    plan->driver = plan->children.empty() ? plan->column : plan->children.front()->driver;
+    return plan;
+}
+
+// plans a field of a record (or the element of a list), which has an entry wherever the definition
+// level is at least definition
+static unique_ptr<PlanNode> plan_field(const schema::Node& field, int16_t definition,
+                                       int16_t repetition, const SchemaDescriptor& schema,
+                                       const ColumnFilter* column_filter, bool implicit_include) {
+    if (field.is_repeated()) {
+        // a repeated field is a (never null, but possibly empty) list of its values
+        unique_ptr<PlanNode> element = plan_value(field, definition + 1, definition + 1,
+                                                  repetition + 1, schema, column_filter,
+                                                  implicit_include);
+        if (!element) {
+            return nullptr;
+        }
+        unique_ptr<PlanNode> plan = make_unique<PlanNode>();
+        plan->type = ObjType::LIST;
+        plan->name = field.name();
+        plan->present_level = definition;
+        plan->defined_level = definition;
+        plan->enclosing_repetition = repetition;
+        plan->element_level = definition + 1;
+        plan->repetition_level = repetition + 1;
+        plan->driver = element->driver;
+        plan->children.push_back(std::move(element));
+        return plan;
+    }
+    int16_t defined = field.is_optional() ? definition + 1 : definition;
+    return plan_value(field, definition, defined, repetition, schema, column_filter,
+                      implicit_include);
+}
+
+// a node on the path from a row to a leaf value
+struct PathStep {
+    const PlanNode* plan;
+    Node* node;
+    // whether the leaf at the end of the path adds the entries of this node
+    bool drives;
+    // the lengths of the lists added so far (for a list driven by the leaf)
+    vector<size_t> lengths;
+};
+
+static void build_nodes(const PlanNode& plan, unique_ptr<Node>& node, vector<PathStep>& path,
+                        map<int, vector<PathStep>>& paths) {
+    switch (plan.type) {
+        case ObjType::RECORD:
+            node = make_unique<RecordNode>();
+            break;
+        case ObjType::LIST:
+            node = make_unique<ListNode>();
+            break;
+        default:
+            node = make_unique<PrimitiveNode>();
+            break;
+    }
+    path.push_back({&plan, node.get(), false, {}});
+    if (plan.type == ObjType::PRIMITIVE) {
+        vector<PathStep>& leaf_path = paths[plan.column];
+        leaf_path = path;
+        for (PathStep& step : leaf_path) {
+            step.drives = step.plan->driver == plan.column;
+        }
+    } else if (plan.type == ObjType::LIST) {
+        build_nodes(*plan.children.front(), static_cast<ListNode&>(*node).get_list(), path, paths);
+    } else {
+        for (const unique_ptr<PlanNode>& child : plan.children) {
+            build_nodes(*child, static_cast<RecordNode&>(*node).get_field(child->name), path,
+                        paths);
+        }
+    }
+    path.pop_back();
+}
+
+// adds the entries described by the levels of a leaf to the nodes on its path that it drives
+static void add_levels(vector<PathStep>& path, const int16_t* def_levels,
+                       const int16_t* rep_levels, int64_t count) {
+    for (int64_t i = 0; i < count; i++) {
+        int16_t definition = def_levels[i];
+        int16_t repetition = rep_levels[i];
+        for (PathStep& step : path) {
+            const PlanNode& plan = *step.plan;
+            if (definition < plan.present_level) {
+                break;
+            }
+            bool defined = definition >= plan.defined_level;
+            if (step.drives && repetition <= plan.enclosing_repetition) {
+                if (defined) {
+                    step.node->add_not_null();
+                    if (plan.type == ObjType::LIST) {
+                        step.lengths.push_back(0);
+                    }
+                } else {
+                    step.node->add_null();
+                }
+            }
+            if (!defined) {
+                break;
+            }
+            if (plan.type == ObjType::LIST) {
+                if (definition < plan.element_level) {
+                    // an empty list
+                    break;
+                }
+                if (step.drives && repetition <= plan.repetition_level) {
+                    step.lengths.back()++;
+                }
+            }
+        }
+    }
+}
+
+// reads the levels of a leaf column, storing its (non-null) values in the leaf node
+class LeafReader {
+   public:
+    virtual ~LeafReader() = default;
+
+    virtual bool has_next() = 0;
+
+    // returns the number of levels read
+    virtual int64_t read(int64_t batch_size, int16_t* def_levels, int16_t* rep_levels) = 0;
+};
+
+template <class DType> class TypedLeafReader : public LeafReader {
+    typedef typename DType::c_type T;
+
+    std::shared_ptr<::parquet::TypedColumnReader<DType>> reader;
+    std::function<void(const T*, int64_t)> store;
+    // (not a vector, which would pack booleans)
+    std::unique_ptr<T[]> values;
+    int64_t values_size = 0;
+
+   public:
+    TypedLeafReader(std::shared_ptr<ColumnReader> reader,
+                    std::function<void(const T*, int64_t)> store)
+        : reader(std::static_pointer_cast<::parquet::TypedColumnReader<DType>>(reader)),
+          store(std::move(store)) {}
+
+    virtual bool has_next() final override {
+        return reader->HasNext();
+    }
+
+    virtual int64_t read(int64_t batch_size, int16_t* def_levels,
+                         int16_t* rep_levels) final override {
+        if (values_size < batch_size) {
+            values.reset(new T[batch_size]);
+            values_size = batch_size;
+        }
+        int64_t values_read = 0;
+        int64_t levels =
+            reader->ReadBatch(batch_size, def_levels, rep_levels, values.get(), &values_read);
+        store(values.get(), values_read);
+        return levels;
+    }
+};
+
+template <class DType, class F>
+static unique_ptr<LeafReader> typed_reader(std::shared_ptr<ColumnReader> reader, F store) {
+    return bamboo::make_unique<TypedLeafReader<DType>>(std::move(reader), std::move(store));
+}
+
+// values with the same width as the node's values are copied in bulk
+template <PrimitiveType P, class DType>
+static unique_ptr<LeafReader> copy_reader(std::shared_ptr<ColumnReader> reader,
+                                          PrimitiveNode& leaf) {
+    typedef typename DType::c_type T;
+    leaf.init_type<P>();
+    auto& values = leaf.get_vector()->get_typed_vector<P>();
+    static_assert(sizeof(T) == sizeof(*values.extend(0)), "Mismatched value widths");
+    return typed_reader<DType>(std::move(reader), [&values](const T* data, int64_t n) {
+        std::memcpy(values.extend(n), data, n * sizeof(T));
+    });
+}
+
+template <PrimitiveType P, class DType>
+static unique_ptr<LeafReader> temporal_reader(std::shared_ptr<ColumnReader> reader,
+                                              PrimitiveNode& leaf, TemporalUnit unit,
+                                              const string& timezone = "") {
+    unique_ptr<LeafReader> leaf_reader = copy_reader<P, DType>(std::move(reader), leaf);
+    leaf.get_vector()->get_typed_vector<P>().set_unit(unit, timezone);
+    return leaf_reader;
+}
+
+static TemporalUnit temporal_unit(LogicalType::TimeUnit::unit unit) {
+    switch (unit) {
+        case LogicalType::TimeUnit::MILLIS:
+            return TemporalUnit::MILLI;
+        case LogicalType::TimeUnit::MICROS:
+            return TemporalUnit::MICRO;
+        case LogicalType::TimeUnit::NANOS:
+            return TemporalUnit::NANO;
+        default:
+            throw std::invalid_argument("Unknown Parquet time unit");
+    }
+}
+
+// decimals backed by integers are sign extended to their 128 bit (little endian) unscaled values
+static void add_decimal(DecimalVector& values, int64_t value) {
+    uint8_t decimal[DecimalVector::byte_width];
+    int64_t high = value < 0 ? -1 : 0;
+    std::memcpy(decimal, &value, sizeof(value));
+    std::memcpy(decimal + sizeof(value), &high, sizeof(high));
+    values.add(decimal);
+}
+
+// decimals backed by byte arrays hold big endian unscaled values (of any width up to 128 bits),
+// which are sign extended
+static void add_decimal(DecimalVector& values, const uint8_t* value, size_t width) {
+    if (width > DecimalVector::byte_width) {
+        throw std::invalid_argument("Decimals wider than 128 bits are not supported");
+    }
+    uint8_t decimal[DecimalVector::byte_width];
+    bool negative = width > 0 && (value[0] & 0x80);
+    std::memset(decimal, negative ? 0xFF : 0, sizeof(decimal));
+    for (size_t j = 0; j < width; j++) {
+        decimal[j] = value[width - 1 - j];
+    }
+    values.add(decimal);
+}
+
+static DecimalVector& init_decimals(const ColumnDescriptor& column, PrimitiveNode& leaf) {
+    leaf.init_type<PrimitiveType::DECIMAL128>();
+    DecimalVector& values = leaf.get_vector()->get_typed_vector<PrimitiveType::DECIMAL128>();
+    values.set_scale(column.type_precision(), column.type_scale());
+    return values;
+}
+
+// julian day number of the unix epoch
+static constexpr int64_t epoch_julian_day = 2440588;
+static constexpr int64_t nanos_per_day = 86400LL * 1000 * 1000 * 1000;
+
+static unique_ptr<LeafReader> leaf_reader(const ColumnDescriptor& column,
+                                          std::shared_ptr<ColumnReader> reader,
+                                          PrimitiveNode& leaf) {
+    const LogicalType& logical = *column.logical_type();
+    switch (column.physical_type()) {
+        case Type::BOOLEAN: {
+            leaf.init_type<PrimitiveType::BOOL>();
+            auto& values = leaf.get_vector()->get_typed_vector<PrimitiveType::BOOL>();
+            return typed_reader<::parquet::BooleanType>(
+                std::move(reader), [&values](const bool* data, int64_t n) {
+                    std::copy(data, data + n, values.extend(n));
+                });
+        }
+        case Type::INT32:
+            if (logical.is_date()) {
+                return temporal_reader<PrimitiveType::DATE32, ::parquet::Int32Type>(
+                    std::move(reader), leaf, TemporalUnit::DAY);
+            } else if (logical.is_time()) {
+                const auto& time = static_cast<const ::parquet::TimeLogicalType&>(logical);
+                return temporal_reader<PrimitiveType::TIME32, ::parquet::Int32Type>(
+                    std::move(reader), leaf, temporal_unit(time.time_unit()));
+            } else if (logical.is_decimal()) {
+                DecimalVector& values = init_decimals(column, leaf);
+                return typed_reader<::parquet::Int32Type>(
+                    std::move(reader), [&values](const int32_t* data, int64_t n) {
+                        for (int64_t i = 0; i < n; i++) {
+                            add_decimal(values, data[i]);
+                        }
+                    });
+            } else if (logical.is_int() &&
+                       !static_cast<const ::parquet::IntLogicalType&>(logical).is_signed()) {
+                return copy_reader<PrimitiveType::UINT32, ::parquet::Int32Type>(std::move(reader),
+                                                                                 leaf);
+            }
+            return copy_reader<PrimitiveType::INT32, ::parquet::Int32Type>(std::move(reader),
+                                                                            leaf);
+        case Type::INT64:
+            if (logical.is_timestamp()) {
+                const auto& timestamp =
+                    static_cast<const ::parquet::TimestampLogicalType&>(logical);
+                return temporal_reader<PrimitiveType::TIMESTAMP, ::parquet::Int64Type>(
+                    std::move(reader), leaf, temporal_unit(timestamp.time_unit()),
+                    timestamp.is_adjusted_to_utc() ? "UTC" : "");
+            } else if (logical.is_time()) {
+                const auto& time = static_cast<const ::parquet::TimeLogicalType&>(logical);
+                return temporal_reader<PrimitiveType::TIME64, ::parquet::Int64Type>(
+                    std::move(reader), leaf, temporal_unit(time.time_unit()));
+            } else if (logical.is_decimal()) {
+                DecimalVector& values = init_decimals(column, leaf);
+                return typed_reader<::parquet::Int64Type>(
+                    std::move(reader), [&values](const int64_t* data, int64_t n) {
+                        for (int64_t i = 0; i < n; i++) {
+                            add_decimal(values, data[i]);
+                        }
+                    });
+            } else if (logical.is_int() &&
+                       !static_cast<const ::parquet::IntLogicalType&>(logical).is_signed()) {
+                return copy_reader<PrimitiveType::UINT64, ::parquet::Int64Type>(std::move(reader),
+                                                                                 leaf);
+            }
+            return copy_reader<PrimitiveType::INT64, ::parquet::Int64Type>(std::move(reader),
+                                                                            leaf);
+        case Type::INT96: {
+            // legacy (e.g. Impala) timestamps: nanoseconds of the day followed by the julian day
+            leaf.init_type<PrimitiveType::TIMESTAMP>();
+            auto& values = leaf.get_vector()->get_typed_vector<PrimitiveType::TIMESTAMP>();
+            values.set_unit(TemporalUnit::NANO);
+            return typed_reader<::parquet::Int96Type>(
+                std::move(reader), [&values](const ::parquet::Int96* data, int64_t n) {
+                    int64_t* out = values.extend(n);
+                    for (int64_t i = 0; i < n; i++) {
+                        uint64_t nanos;
+                        std::memcpy(&nanos, data[i].value, sizeof(nanos));
+                        out[i] = (static_cast<int64_t>(data[i].value[2]) - epoch_julian_day) *
+                                     nanos_per_day +
+                                 static_cast<int64_t>(nanos);
+                    }
+                });
+        }
+        case Type::FLOAT:
+            return copy_reader<PrimitiveType::FLOAT32, ::parquet::FloatType>(std::move(reader),
+                                                                              leaf);
+        case Type::DOUBLE:
+            return copy_reader<PrimitiveType::FLOAT64, ::parquet::DoubleType>(std::move(reader),
+                                                                               leaf);
+        case Type::BYTE_ARRAY: {
+            if (logical.is_decimal()) {
+                DecimalVector& values = init_decimals(column, leaf);
+                return typed_reader<::parquet::ByteArrayType>(
+                    std::move(reader), [&values](const ::parquet::ByteArray* data, int64_t n) {
+                        for (int64_t i = 0; i < n; i++) {
+                            add_decimal(values, data[i].ptr, data[i].len);
+                        }
+                    });
+            }
+            bool is_string = logical.is_string() || logical.is_enum() || logical.is_JSON();
+            if (is_string) {
+                leaf.init_type<PrimitiveType::STRING>();
+            } else {
+                leaf.init_type<PrimitiveType::BYTE_ARRAY>();
+            }
+            BinaryVector& values = static_cast<BinaryVector&>(*leaf.get_vector());
+            return typed_reader<::parquet::ByteArrayType>(
+                std::move(reader), [&values](const ::parquet::ByteArray* data, int64_t n) {
+                    values.reserve(n);
+                    for (int64_t i = 0; i < n; i++) {
+                        values.add(reinterpret_cast<const char*>(data[i].ptr), data[i].len);
+                    }
+                });
+        }
+        case Type::FIXED_LEN_BYTE_ARRAY: {
+            size_t width = column.type_length();
+            if (logical.is_decimal()) {
+                if (width > DecimalVector::byte_width) {
+                    throw std::invalid_argument("Decimals wider than 128 bits are not supported");
+                }
+                DecimalVector& values = init_decimals(column, leaf);
+                return typed_reader<::parquet::FLBAType>(
+                    std::move(reader),
+                    [&values, width](const ::parquet::FixedLenByteArray* data, int64_t n) {
+                        for (int64_t i = 0; i < n; i++) {
+                            add_decimal(values, data[i].ptr, width);
+                        }
+                    });
+            }
+            leaf.init_fixed(width);
+            FixedBinaryVector& values =
+                leaf.get_vector()->get_typed_vector<PrimitiveType::FIXED_BYTE_ARRAY>();
+            return typed_reader<::parquet::FLBAType>(
+                std::move(reader), [&values](const ::parquet::FixedLenByteArray* data, int64_t n) {
+                    values.reserve(n);
+                    for (int64_t i = 0; i < n; i++) {
+                        values.add(data[i].ptr);
+                    }
+                });
+        }
+        default:
+            throw std::invalid_argument("Unsupported Parquet type");
+    }
+}
+
+static constexpr int64_t level_batch_size = 65536;
+
+static void read_leaf(LeafReader& reader, const ColumnDescriptor& column,
+                      vector<PathStep>& path) {
+    vector<int16_t> def_levels(level_batch_size, 0);
+    // (the reader only writes the levels a column has)
+    vector<int16_t> rep_levels(level_batch_size, 0);
+    bool flat = column.max_definition_level() == 0 && column.max_repetition_level() == 0;
+    while (reader.has_next()) {
+        int64_t levels = reader.read(level_batch_size, def_levels.data(), rep_levels.data());
+        if (flat) {
+            // every node on the path has an entry for each (non-null) value
+            for (PathStep& step : path) {
+                if (step.drives) {
+                    step.node->append_validity(nullptr, 0, levels, 0);
+                }
+            }
+        } else {
+            add_levels(path, def_levels.data(), rep_levels.data(), levels);
+        }
+    }
+    for (PathStep& step : path) {
+        if (step.drives && step.plan->type == ObjType::LIST) {
+            ListNode& ln = static_cast<ListNode&>(*step.node);
+            for (size_t length : step.lengths) {
+                ln.add_list(length);
+            }
+            vector<size_t>().swap(step.lengths);
+        }
+    }
+}
+
+static unique_ptr<RecordNode> convert_row_group(::parquet::RowGroupReader& row_group,
+                                                const SchemaDescriptor& schema,
+                                                const PlanNode& plan) {
+    unique_ptr<RecordNode> rn = make_unique<RecordNode>();
+    map<int, vector<PathStep>> paths;
+    vector<PathStep> path;
+    for (const unique_ptr<PlanNode>& child : plan.children) {
+        build_nodes(*child, rn->get_field(child->name), path, paths);
+    }
+    // the leaves are read in column order, so the first leaf below a node drives it
+    for (auto& leaf_path : paths) {
+        const ColumnDescriptor& column = *schema.Column(leaf_path.first);
+        PrimitiveNode& leaf = static_cast<PrimitiveNode&>(*leaf_path.second.back().node);
+        unique_ptr<LeafReader> reader =
+            leaf_reader(column, row_group.Column(leaf_path.first), leaf);
+        read_leaf(*reader, column, leaf_path.second);
+    }
+    rn->append_validity(nullptr, 0, row_group.metadata()->num_rows(), 0);
+    return rn;
+}
+
+unique_ptr<Node> convert_file(const string& path, const ColumnFilter* column_filter,
+                              size_t expected_rows, size_t threads) {
+    bool implicit_include = !column_filter || !column_filter->has_includes();
+    std::unique_ptr<ParquetFileReader> file = ParquetFileReader::OpenFile(path, true);
+    std::shared_ptr<::parquet::FileMetaData> metadata = file->metadata();
+    const SchemaDescriptor& schema = *metadata->schema();
+
+    unique_ptr<PlanNode> plan = plan_value(*schema.group_node(), 0, 0, 0, schema, column_filter,
+                                           implicit_include);
+    if (!plan) {
+        return make_unique<IncompleteNode>();
+    }
+
+    size_t count = metadata->num_row_groups();
+    threads = std::max<size_t>(1, std::min(thread_count(threads), count));
+
+    vector<unique_ptr<RecordNode>> row_group_nodes(count);
+    parallel_for(threads, [&](size_t thread) {
+        // each thread reads through its own (memory mapped) reader, sharing the parsed footer (the
+        // values are copied out of the pages, so the mapping is only read during the conversion)
+        std::unique_ptr<ParquetFileReader> reader = ParquetFileReader::OpenFile(
+            path, true, ::parquet::default_reader_properties(), metadata);
+        for (size_t i = thread; i < count; i += threads) {
+            std::shared_ptr<::parquet::RowGroupReader> row_group = reader->RowGroup(i);
+            row_group_nodes[i] = convert_row_group(*row_group, schema, *plan);
+        }
+    });
+
+    unique_ptr<ListNode> ln = make_unique<ListNode>();
+    ln->get_list() = make_unique<RecordNode>();
+    int64_t list_counter = 0;
+    size_t rows = expected_rows ? expected_rows : metadata->num_rows();
+    for (size_t i = 0; i < count; i++) {
+        concat(ln->get_list(), *row_group_nodes[i]);
+        row_group_nodes[i].reset();
+        list_counter += metadata->RowGroup(i)->num_rows();
+        // (the first row group's columns are moved into the list, so room for the rest is only
+        // reserved once they are)
+        if (i == 0 && rows > static_cast<size_t>(list_counter)) {
+            ln->get_list()->reserve(rows - list_counter);
+        }
+    }
+    ln->add_list(list_counter);
+    ln->add_not_null();
+
+    return std::move(ln);
+}
+
+}  // namespace parquet
+}  // namespace bamboo
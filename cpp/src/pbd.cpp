@@ -15,6 +15,10 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <algorithm>
+#include <boost/iostreams/device/array.hpp>
+#include <boost/iostreams/stream.hpp>
+
 #include <pbd.hpp>
 
 namespace bamboo {
@@ -49,9 +53,7 @@ bool FieldDescriptor::has_fields() const
 
 void MessageDescriptor::add_field(const pb::FieldDescriptor* field,
                                   const ColumnFilter* column_filter, bool implicit_include) {
-    bool explicit_include = column_filter && column_filter->explicitly_include;
-    bool explicit_exclude = column_filter && column_filter->explicitly_exclude;
-    bool included = explicit_include || (implicit_include && !explicit_exclude);
+    bool included = ColumnFilter::included(column_filter, implicit_include);
 
     int index = fields.size();
     auto fieldDesc = std::make_shared<FieldDescriptor>(field, index, column_filter, included);
@@ -72,13 +74,9 @@ MessageDescriptor::MessageDescriptor(const pb::Descriptor* pb_descriptor,
     : pb_descriptor(pb_descriptor) {
     // if using a different map type, we should reserve space here
     for (int i = 0; i < pb_descriptor->field_count(); i++) {
-        const ColumnFilter* field_filter = nullptr;
         const pb::FieldDescriptor* field = pb_descriptor->field(i);
-        const string& field_name = field->name();
-        if (column_filter && column_filter->field_filters.count(field_name)) {
-            field_filter = column_filter->field_filters.at(field_name).get();
-        }
-        add_field(pb_descriptor->field(i), field_filter, implicit_include);
+        const ColumnFilter* field_filter = ColumnFilter::child(column_filter, field->name());
+        add_field(field, field_filter, implicit_include);
     }
 }
 
@@ -149,7 +147,8 @@ void initialize(const MessageDescriptor* descriptor, unique_ptr<Node>& node) {
     }
 }
 
-unique_ptr<Node> convert(std::istream& is, const ColumnFilter* column_filter) {
+unique_ptr<Node> convert(std::istream& is, const ColumnFilter* column_filter,
+                         size_t expected_rows) {
     PBDReader reader(is);
     PBDConverter converter;
     unique_ptr<Node> node = make_unique<IncompleteNode>();
@@ -157,6 +156,9 @@ unique_ptr<Node> convert(std::istream& is, const ColumnFilter* column_filter) {
     MessageDescriptor descriptor(reader.descriptor(), column_filter,
                                  !column_filter || !column_filter->has_includes());
     initialize(&descriptor, node);
+    if (expected_rows) {
+        node->reserve(expected_rows);
+    }
     Datum datum(reader.stream(), &descriptor);
     int protoMessageSize = 0;
     while (datum.stream.ReadVarintSizeAsInt(&protoMessageSize)) {
@@ -167,6 +169,15 @@ unique_ptr<Node> convert(std::istream& is, const ColumnFilter* column_filter) {
     return node;
 }
 
+// the reader only takes a stream, but reading from an array source avoids any round trips to the
+// original source (e.g. a Python stream) while the messages are decoded
+unique_ptr<Node> convert(const char* data, size_t size, const ColumnFilter* column_filter,
+                         size_t expected_rows) {
+    namespace io = boost::iostreams;
+    io::stream<io::array_source> is(data, size);
+    return convert(is, column_filter, expected_rows);
+}
+
 ObjType PBDConverter::type(Datum& datum) {
     if (datum.field) {
         if (datum.field->pb_field->is_repeated() && !datum.reading_list) {
@@ -195,7 +206,7 @@ ListIterator PBDConverter::get_list(Datum& datum) {
 struct ProtoEnum final : public DynamicEnum {
     const pb::EnumDescriptor* descriptor;
 
-    PrimitiveSimpleVector<string> enum_values;
+    BinaryVector enum_values;
 
     ProtoEnum(const pb::EnumDescriptor* descriptor) : descriptor(descriptor) {
         for (size_t i = 0; i < descriptor->value_count(); i++) {
@@ -260,8 +271,7 @@ static inline void add_missing(PrimitiveNode& v, Datum& datum) {
             break;
         case pb::FieldDescriptor::TYPE_BYTES: {
             const string& s = field->default_value_string();
-            std::vector<uint8_t> vec(s.begin(), s.end());
-            v.add_unsafe(vec);
+            std::copy(s.begin(), s.end(), v.add_bytes(s.size()));
             break;
         }
         case pb::FieldDescriptor::TYPE_UINT32:
@@ -277,6 +287,16 @@ static inline void add_missing(PrimitiveNode& v, Datum& datum) {
     }
 }
 
+// the length prefix is untrusted, so it is checked against what remains of the message before any
+// space is reserved for the value
+static inline bool read_length(pb::io::CodedInputStream& stream, uint32_t& length) {
+    if (!stream.ReadVarint32(&length)) {
+        return false;
+    }
+    int remaining = stream.BytesUntilLimit();
+    return remaining < 0 || length <= static_cast<uint32_t>(remaining);
+}
+
 static inline void add_existing(PrimitiveNode& v, Datum& datum) {
     const pb::FieldDescriptor* field = datum.field->pb_field;
     switch (field->type()) {
@@ -323,16 +343,19 @@ static inline void add_existing(PrimitiveNode& v, Datum& datum) {
             break;
         }
         case pb::FieldDescriptor::TYPE_STRING: {
-            string& s = v.add_string();
-            WireFormatLite::ReadString(&datum.stream, &s);
+            uint32_t length;
+            if (!read_length(datum.stream, length) ||
+                !datum.stream.ReadRaw(v.add_string(length), length)) {
+                throw std::runtime_error("Unable to read string");
+            }
             break;
         }
         case pb::FieldDescriptor::TYPE_BYTES: {
-            // this causes unnecessary copying, it should be made more efficient
-            string s;
-            WireFormatLite::ReadBytes(&datum.stream, &s);
-            std::vector<uint8_t> vec(s.begin(), s.end());
-            v.add_unsafe(vec);
+            uint32_t length;
+            if (!read_length(datum.stream, length) ||
+                !datum.stream.ReadRaw(v.add_bytes(length), length)) {
+                throw std::runtime_error("Unable to read bytes");
+            }
             break;
         }
         case pb::FieldDescriptor::TYPE_UINT32: {
@@ -1,4 +1,5 @@
 from bamboo.nodes import FlattenStrategy, NameStrategy, JoinType
-from bamboo.core import from_object, from_arrow, from_avro, from_json, from_pbd
+from bamboo.core import from_object, from_arrow, from_arrow_file, from_avro, from_json, from_parquet, \
+    from_pbd
 
 from bamboo_cpp_bind import __version__
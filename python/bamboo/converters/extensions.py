@@ -16,9 +16,10 @@
 # limitations under the License.
 
 import bamboo_cpp_bind as bc
+import pandas as pd
 
 from bamboo.nodes import Node, IncompleteNode, ListNode, PrimitiveNode, RecordNode, RecordField, IndexNullIndicator, \
-    OrderedRangeIndex
+    MaskNullIndicator, OrderedRangeIndex
 from bamboo.util import ArrayList
 
 
@@ -29,8 +30,39 @@ def add_node_reference(node, extension_node):
     return node
 
 
+class ExtensionValues(ArrayList):
+    # the values of a primitive extension node are only requested when they are first used, as requesting them makes
+    # values held in several runs (e.g. values used in place from several Arrow record batches) contiguous
+    def __init__(self, node, growth_rate=1.5):
+        self.growth_rate = growth_rate
+        self.size = node.get_size() - node.get_null_count()
+        self._node = node
+        self._values = None
+
+    @property
+    def values(self):
+        if self._values is None:
+            self._values = localize(self._node.get_values(), self._node.get_timezone())
+        return self._values
+
+
+def localize(values, timezone):
+    # timestamps with a time zone are held as UTC, and are given as time zone aware timestamps
+    if timezone is None:
+        return values
+    return pd.DatetimeIndex(values).tz_localize('UTC').tz_convert(timezone)
+
+
+def convert_null_indicator(node):
+    # dense nulls are stored as a bitmap on the C++ side, which we expand once into a mask rather than into indices
+    if node.is_null_bitmap():
+        return MaskNullIndicator(node.get_not_null_mask(), node.get_null_count())
+    else:
+        return IndexNullIndicator(ArrayList(node.get_null_indices()), node.get_size())
+
+
 def convert_extension_node(node):
-    null_indicator = IndexNullIndicator(ArrayList(node.get_null_indices()), node.get_size())
+    null_indicator = convert_null_indicator(node)
     if isinstance(node, bc.RecordNode):
         fields = [RecordField(name, convert_extension_node(node.get_field(name))) for name in node.get_fields()]
         return add_node_reference(RecordNode(fields, null_indicator), node)
@@ -38,7 +70,7 @@ def convert_extension_node(node):
         index = OrderedRangeIndex(ArrayList(node.get_index()))
         return add_node_reference(ListNode(convert_extension_node(node.get_list()), index, null_indicator), node)
     elif isinstance(node, bc.PrimitiveNode):
-        return add_node_reference(PrimitiveNode(ArrayList(node.get_values()), null_indicator), node)
+        return add_node_reference(PrimitiveNode(ExtensionValues(node), null_indicator), node)
     elif isinstance(node, bc.IncompleteNode):
         return add_node_reference(IncompleteNode(null_indicator), node)
     else:
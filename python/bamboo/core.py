@@ -17,8 +17,9 @@
 
 import bamboo_cpp_bind as bamboo_cpp
 
+import json
+
 import six
-from io import BytesIO
 
 from bamboo.converters.extensions import convert_extension_node
 from bamboo.converters.obj import PythonObjConverter
@@ -27,28 +28,99 @@ from bamboo.nodes import build
 from bamboo.clusions import convert_clusions
 
 
+# the converters read paths (given as strings) natively, so path-like objects are passed as strings
+def _input(s):
+    if hasattr(s, '__fspath__'):
+        return six.ensure_text(s.__fspath__())
+    return s
+
+
 def from_object(obj, dict_as_record=True):
     node = IncompleteNode.create()
     converter = PythonObjConverter(dict_as_record)
     return build(obj, node, converter)
 
 
-def from_avro(s, include=None, exclude=None):
-    extension_node = bamboo_cpp.convert_avro(s, convert_clusions(include, exclude))
+# with more than one thread (0 for one per core), the blocks of the file are decoded in parallel;
+# unless s is a file that can be mapped (or a buffer), this first reads the whole stream into memory
+def from_avro(s, include=None, exclude=None, expected_rows=0, threads=1):
+    extension_node = bamboo_cpp.convert_avro(_input(s), convert_clusions(include, exclude),
+                                             expected_rows, threads)
+    return convert_extension_node(extension_node)
+
+
+def from_arrow(s, include=None, exclude=None, expected_rows=0):
+    extension_node = bamboo_cpp.convert_arrow(_input(s), convert_clusions(include, exclude),
+                                              expected_rows)
+    return convert_extension_node(extension_node)
+
+
+# reads an Arrow IPC file (i.e. Feather v2), optionally only the batches in [begin_batch, end_batch)
+# (only the footer and the buffers of those batches are read from the file); the options are
+# keyword only, as in from_json
+def from_arrow_file(path, *, include=None, exclude=None, begin_batch=0, end_batch=-1, threads=1):
+    extension_node = bamboo_cpp.convert_arrow_file(_input(path), convert_clusions(include, exclude),
+                                                   begin_batch, end_batch, threads)
     return convert_extension_node(extension_node)
 
 
-def from_arrow(s):
-    return convert_extension_node(bamboo_cpp.convert_arrow(s))
+# reads (by memory mapping) a Parquet file, converting its row groups in parallel on the given
+# number of threads (0 for one per core); the options are keyword only, as in from_json
+def from_parquet(path, *, include=None, exclude=None, expected_rows=0, threads=1):
+    extension_node = bamboo_cpp.convert_parquet(_input(path), convert_clusions(include, exclude),
+                                                expected_rows, threads)
+    return convert_extension_node(extension_node)
+
+
+def from_pbd(s, include=None, exclude=None, expected_rows=0):
+    extension_node = bamboo_cpp.convert_pbd(_input(s), convert_clusions(include, exclude),
+                                            expected_rows)
+    return convert_extension_node(extension_node)
+
 
+# the bamboo_cpp_bind node behind a node returned by one of the from_ functions (extension nodes are
+# returned as they are)
+def _extension_node(node):
+    return getattr(node, '__extension_node', node)
 
-def from_pbd(s, include=None, exclude=None):
-    return convert_extension_node(bamboo_cpp.convert_pbd(s, convert_clusions(include, exclude)))
 
+# combines nodes returned by the from_ functions or by the bamboo_cpp_bind converters (e.g. shards of
+# a dataset that were converted separately) into a new node; the values are copied, so the given
+# nodes (and any arrays of their values) are left as they were
+def concat(nodes):
+    return convert_extension_node(bamboo_cpp.concat([_extension_node(node) for node in nodes]))
 
-def from_json(s):
-    if isinstance(s, str):
-        extension_node = bamboo_cpp.convert_json(BytesIO(six.ensure_binary(s, 'utf-8')))
+
+# an Avro schema (as JSON text, or parsed) is converted to the nodes it describes; a node returned
+# by one of the bamboo_cpp_bind converters is used as it is
+def _json_schema(schema):
+    # (the result of an earlier conversion wraps its node)
+    schema = _extension_node(schema)
+    if schema is None or isinstance(schema, bamboo_cpp.Node):
+        return schema
+    if not isinstance(schema, six.string_types):
+        schema = json.dumps(schema)
+    return bamboo_cpp.json_schema(schema)
+
+
+# a string is converted as JSON text; a file is read from a path-like object. With lines, the input
+# is newline delimited JSON (with a list entry for each line), which is parsed in parallel on the
+# given number of threads (0 for one per core). A schema (of the document, or of each line) types
+# the columns up front, and numbers are converted to the declared types. expected_rows is a hint for
+# the number of entries (or lines). The options are keyword only, so that adding one can not
+# silently rebind a positional argument.
+def from_json(s, *, include=None, exclude=None, schema=None, lines=False, threads=1,
+              expected_rows=0):
+    if isinstance(s, six.text_type):
+        # the encoded bytes are parsed in place
+        s = s.encode('utf-8')
+    else:
+        s = _input(s)
+    column_filter = convert_clusions(include, exclude)
+    schema = _json_schema(schema)
+    if lines:
+        extension_node = bamboo_cpp.convert_json_lines(s, column_filter, schema, expected_rows,
+                                                       threads)
     else:
-        extension_node = bamboo_cpp.convert_json(s)
+        extension_node = bamboo_cpp.convert_json(s, column_filter, schema, expected_rows)
     return convert_extension_node(extension_node)
@@ -31,6 +31,9 @@ class NullIndicator(object):
     def not_null_indices(self):
         raise NotImplementedError('Must be overridden in subclass')
 
+    def not_null_mask(self):
+        raise NotImplementedError('Must be overridden in subclass')
+
     def size(self):
         raise NotImplementedError('Must be overridden in subclass')
 
@@ -55,6 +58,11 @@ class IndexNullIndicator(NullIndicator):
         null_indices = self._indices.values[:self._indices.size]
         return np.delete(all_indices, null_indices)
 
+    def not_null_mask(self):
+        mask = np.ones(self._size, dtype=np.bool_)
+        mask[self._indices.values[:self._indices.size]] = False
+        return mask
+
     def size(self):
         return self._size
 
@@ -67,6 +75,31 @@ class IndexNullIndicator(NullIndicator):
         return IndexNullIndicator(indices, 0)
 
 
+# a read only null indicator backed by a boolean mask (which is True for values that are not null)
+class MaskNullIndicator(NullIndicator):
+    def __init__(self, mask, null_size):
+        self._mask = mask
+        self._null_size = null_size
+
+    def add_not_null(self):
+        raise NotImplementedError('Mask null indicators are read only')
+
+    def add_null(self):
+        raise NotImplementedError('Mask null indicators are read only')
+
+    def not_null_indices(self):
+        return np.flatnonzero(self._mask)
+
+    def not_null_mask(self):
+        return self._mask
+
+    def size(self):
+        return self._mask.size
+
+    def null_size(self):
+        return self._null_size
+
+
 def fill_value(dtype):
     if np.issubdtype(dtype, np.integer):
         return 0
@@ -74,6 +107,10 @@ def fill_value(dtype):
         return np.nan
     elif np.issubdtype(dtype, np.bool_):
         return False
+    elif np.issubdtype(dtype, np.datetime64):
+        return np.datetime64('NaT', np.datetime_data(dtype)[0])
+    elif np.issubdtype(dtype, np.timedelta64):
+        return np.timedelta64('NaT', np.datetime_data(dtype)[0])
     elif np.issubdtype(dtype, np.object_):
         return None
 
@@ -81,12 +118,18 @@ def fill_value(dtype):
 def expand_array_with_nulls(array, nulls):
     if nulls.null_size() == 0:
         return array
+    elif isinstance(array, pd.DatetimeIndex) and array.tz is not None:
+        # time zone aware timestamps are expanded as UTC datetimes
+        expanded = expand_array_with_nulls(array.tz_convert('UTC').tz_localize(None).values, nulls)
+        return pd.DatetimeIndex(expanded).tz_localize('UTC').tz_convert(array.tz)
+    elif isinstance(array, pd.Categorical):
+        codes = np.full(nulls.size(), -1, dtype=array.codes.dtype)
+        codes[nulls.not_null_mask()] = array.codes
+        return pd.Categorical.from_codes(codes, categories=array.categories, ordered=array.ordered)
     else:
-        # inefficient to repeat expanding, should fix
-        not_null_indices = nulls.not_null_indices()
         # fill value should be more explicitly handled
         values = np.full(nulls.size(), fill_value(array.dtype))
-        values[not_null_indices] = array
+        values[nulls.not_null_mask()] = array
         return values
 
 
@@ -21,7 +21,7 @@ import numpy as np
 class ArrayList:
     def __init__(self, values, growth_rate=1.5):
         self.growth_rate = growth_rate
-        self.size = values.size
+        self.size = len(values)
         self.values = values
 
     @classmethod
@@ -36,19 +36,130 @@ def pyarrow_runner(pipe):
         else:
             pipe.send(r())
 
-def convert(arr, create_list=True):
+def write_stream(batches, options=None):
     import pyarrow as pa
     sink = pa.BufferOutputStream()
-    batch = pa.RecordBatch.from_arrays([arr], [FIELD_NAME])
-    writer = pa.RecordBatchStreamWriter(sink, batch.schema)
-    writer.write_batch(batch)
+    if options:
+        writer = pa.ipc.new_stream(sink, batches[0].schema, options=options)
+    else:
+        writer = pa.RecordBatchStreamWriter(sink, batches[0].schema)
+    for batch in batches:
+        writer.write_batch(batch)
     writer.close()
     sink.flush()
+    return bytes(sink.getvalue())
+
+
+def write_file(batches):
+    import pyarrow as pa
+    import tempfile
+    with tempfile.NamedTemporaryFile(suffix='.arrow', delete=False) as f:
+        path = f.name
+    writer = pa.RecordBatchFileWriter(path, batches[0].schema)
+    for batch in batches:
+        writer.write_batch(batch)
+    writer.close()
+    return path
+
+
+def convert(arr, create_list=True):
+    import pyarrow as pa
+    batch = pa.RecordBatch.from_arrays([arr], [FIELD_NAME])
     if create_list:
         l = np.array(arr).tolist()
     else:
         l = None
-    return bytes(sink.getvalue()), l
+    return write_stream([batch]), l
+
+
+def create_batches():
+    import pyarrow as pa
+    batches = [pa.RecordBatch.from_arrays([pa.array(ints, type=pa.int64()), pa.array(strings)],
+                                          [FIELD_NAME, 'str'])
+               for ints, strings in [([1, 2], [u'a', None]), ([None, 3, 4], [u'b', u'c', None])]]
+    return write_stream(batches)
+
+
+def create_int_batches():
+    import pyarrow as pa
+    batches = [pa.RecordBatch.from_arrays([pa.array(list(range(i, i + 100)), type=pa.int64())], [FIELD_NAME])
+               for i in range(0, 300, 100)]
+    return write_stream(batches)
+
+
+def dictionary_batch(dictionary, indices):
+    import pyarrow as pa
+    return pa.RecordBatch.from_arrays([pa.DictionaryArray.from_arrays(pa.array(indices, type=pa.int8()),
+                                                                       pa.array(dictionary))], [FIELD_NAME])
+
+
+def create_dictionary_batches():
+    import pyarrow as pa
+    dictionary = pa.array([u'foo', u'bar'])
+    batches = [pa.RecordBatch.from_arrays([pa.DictionaryArray.from_arrays(pa.array(indices, type=pa.int8()),
+                                                                           dictionary)], [FIELD_NAME])
+               for indices in [[0, 1], [1, None, 0]]]
+    return write_stream(batches)
+
+
+def create_delta_dictionary_batches():
+    import pyarrow as pa
+    batches = [dictionary_batch([u'foo', u'bar'], [0, 1]), dictionary_batch([u'foo', u'bar', u'baz'], [2, None, 0])]
+    try:
+        options = pa.ipc.IpcWriteOptions(emit_dictionary_deltas=True)
+    except (AttributeError, TypeError):
+        # older versions of pyarrow cannot write delta dictionaries
+        return None
+    return write_stream(batches, options)
+
+
+def join_streams(streams):
+    # joins streams of the same schema, so that the dictionaries of each stream replace those of the
+    # previous ones (older versions of pyarrow do not write replaced dictionaries themselves)
+    import pyarrow as pa
+    sink = pa.BufferOutputStream()
+    for i, stream in enumerate(streams):
+        reader = pa.ipc.MessageReader.open_stream(pa.BufferReader(stream))
+        while True:
+            try:
+                message = reader.read_next_message()
+            except StopIteration:
+                break
+            if i == 0 or message.type != 'schema':
+                sink.write(message.serialize())
+    # the end of stream marker
+    sink.write(b'\xff\xff\xff\xff\x00\x00\x00\x00')
+    return bytes(sink.getvalue())
+
+
+def create_replaced_dictionary_batches():
+    return join_streams([write_stream([dictionary_batch([u'foo', u'bar'], [0, 1])]),
+                         write_stream([dictionary_batch([u'foo', u'bar', u'baz'], [2, None, 0])])])
+
+
+def create_mixed_dictionary_batches():
+    return join_streams([write_stream([dictionary_batch([u'foo', u'bar'], [0, 1])]),
+                         write_stream([dictionary_batch([u'baz', u'foo'], [0, None, 1])])])
+
+
+def create_file():
+    import pyarrow as pa
+    batches = [pa.RecordBatch.from_arrays([pa.array([i, i + 1, None], type=pa.int64())], [FIELD_NAME])
+               for i in range(0, 9, 3)]
+    return write_file(batches)
+
+
+def create_nested_file():
+    import pyarrow as pa
+    batches = [pa.RecordBatch.from_arrays([pa.array([i * 3, i * 3 + 1, i * 3 + 2], type=pa.int64()),
+                                           pa.array([u'a{}'.format(i), None, u'']),
+                                           pa.array([[i, i + 1], None, []], type=pa.list_(pa.int64())),
+                                           pa.array([{'x': i, 'y': [{'a': i}]}, {'x': None, 'y': []},
+                                                     {'x': 7, 'y': None}])],
+                                          [FIELD_NAME, 'str', 'list', 'record'])
+               for i in range(3)]
+    return write_file(batches)
+
 
 def create_int8():
     import pyarrow as pa
@@ -75,6 +186,39 @@ def create_time32():
     return convert(pa.array(np.array([1, 2], dtype='int32'), pa.time32('s')))
 
 
+def create_date32():
+    import pyarrow as pa
+    return convert(pa.array([0, None, 365], type=pa.date32()), create_list=False)
+
+
+def create_timestamp():
+    import pyarrow as pa
+    return convert(pa.array([1, 2], type=pa.timestamp('ms', tz='America/New_York')), create_list=False)
+
+
+def create_decimal():
+    import pyarrow as pa
+    from decimal import Decimal
+    return convert(pa.array([Decimal('1.25'), None, Decimal('-3.50')], type=pa.decimal128(5, 2)),
+                   create_list=False)
+
+
+WIDE_DECIMALS = ['12345678901234567890123456789.012345678', '-0.000000001',
+                 '-99999999999999999999999999999.999999999']
+
+
+def create_wide_decimal():
+    import pyarrow as pa
+    from decimal import Decimal
+    return convert(pa.array([Decimal(value) for value in WIDE_DECIMALS], type=pa.decimal128(38, 9)),
+                   create_list=False)
+
+
+def create_fixed_binary():
+    import pyarrow as pa
+    return convert(pa.array([b'ab', None, b'cd'], type=pa.binary(2)), create_list=False)
+
+
 def create_null_time32():
     import pyarrow as pa
     return convert(pa.array(np.array([1, None], dtype='int32'), pa.time32('s')))  # arrow complains about the null int
@@ -105,6 +249,21 @@ def create_binary():
     return convert(pa.array('test', type=pa.binary()))
 
 
+def create_string():
+    import pyarrow as pa
+    return convert(pa.array([u'a', u'', u'bcd'], type=pa.string()))
+
+
+def create_null_string():
+    import pyarrow as pa
+    return convert(pa.array([u'a', None, u'bcd'], type=pa.string()), create_list=False)
+
+
+def create_null_bool():
+    import pyarrow as pa
+    return convert(pa.array([False, None, True], type=pa.bool_()), create_list=False)
+
+
 def create_bool():
     import pyarrow as pa
     return convert(pa.array([False, True], type=pa.bool_()))
@@ -161,6 +320,194 @@ class ArrowTests(TestCase):
         node = self.array_convert(b)
         self.assertListEqual(node.get_values().tolist(), arr)
 
+    def test_batches(self):
+        import bamboo_cpp_bind as bamboo_cpp
+        b = self.pa(create_batches)
+        # (the expected rows are only a hint)
+        self.assertListEqual(bamboo_cpp.convert_arrow(b, expected_rows=100).get_index().tolist(),
+                             [5])
+        node = bamboo_cpp.convert_arrow(io.BytesIO(b))
+        self.assertListEqual(node.get_index().tolist(), [5])
+        records = node.get_list()
+        self.assertEqual(records.get_size(), 5)
+        ints = records.get_field(FIELD_NAME)
+        self.assertListEqual(ints.get_values().tolist(), [1, 2, 3, 4])
+        self.assertListEqual(ints.get_null_indices().tolist(), [2])
+        strings = records.get_field('str')
+        self.assertListEqual(strings.get_values().tolist(), ['a', 'b', 'c'])
+        self.assertListEqual(strings.get_null_indices().tolist(), [1, 4])
+
+    def test_batches_in_place(self):
+        from bamboo import from_arrow
+        from bamboo.core import _extension_node
+        b = self.pa(create_int_batches)
+        start = np.frombuffer(b, dtype=np.uint8).__array_interface__['data'][0]
+        node = from_arrow(b)
+        ints = _extension_node(node).get_list().get_field(FIELD_NAME)
+        # each batch is still a run of values in the input buffer (converting the node did not copy them)
+        chunks = ints.get_value_chunks()
+        self.assertEqual(len(chunks), 3)
+        for i, chunk in enumerate(chunks):
+            address = chunk.__array_interface__['data'][0]
+            self.assertTrue(start <= address < start + len(b))
+            self.assertListEqual(chunk.tolist(), list(range(i * 100, (i + 1) * 100)))
+        df_equality(self, {FIELD_NAME: list(range(300))}, node.flatten())
+
+    def test_batches_outlive_flatten(self):
+        import gc
+        from bamboo import from_arrow
+        from bamboo.core import _extension_node
+        # the batches of a stream are held in buffers allocated while reading it (not in the input)
+        s = io.BytesIO(self.pa(create_int_batches))
+        node = from_arrow(s)
+        ints = _extension_node(node).get_list().get_field(FIELD_NAME)
+        chunks = ints.get_value_chunks()
+        self.assertEqual(len(chunks), 3)
+        # flattening copies the runs into a single vector, which must not release the batches the
+        # chunks still view
+        df_equality(self, {FIELD_NAME: list(range(300))}, node.flatten())
+        del s
+        gc.collect()
+        for i, chunk in enumerate(chunks):
+            self.assertListEqual(chunk.tolist(), list(range(i * 100, (i + 1) * 100)))
+
+    def test_dictionary_batches(self):
+        import bamboo_cpp_bind as bamboo_cpp
+        b = self.pa(create_dictionary_batches)
+        node = bamboo_cpp.convert_arrow(io.BytesIO(b))
+        values = node.get_list().get_field(FIELD_NAME)
+        self.assertListEqual(values.get_values().tolist(), ['foo', 'bar', 'bar', 'foo'])
+        self.assertListEqual(values.get_null_indices().tolist(), [3])
+        self.assertListEqual(list(values.get_values().categories), ['foo', 'bar'])
+
+    def test_delta_dictionary_batches(self):
+        import bamboo_cpp_bind as bamboo_cpp
+        b = self.pa(create_delta_dictionary_batches)
+        if b is None:
+            self.skipTest('this version of pyarrow cannot write delta dictionaries')
+        values = bamboo_cpp.convert_arrow(io.BytesIO(b)).get_list().get_field(FIELD_NAME)
+        self.assertListEqual(list(values.get_values().categories), ['foo', 'bar', 'baz'])
+        self.assertListEqual(values.get_values().codes.tolist(), [0, 1, 2, 0])
+        self.assertListEqual(values.get_null_indices().tolist(), [3])
+
+    def test_replaced_dictionary_batches(self):
+        import bamboo_cpp_bind as bamboo_cpp
+        # a replacement that extends the dictionary keeps the codes of the earlier batches
+        b = self.pa(create_replaced_dictionary_batches)
+        values = bamboo_cpp.convert_arrow(io.BytesIO(b)).get_list().get_field(FIELD_NAME)
+        self.assertListEqual(list(values.get_values().categories), ['foo', 'bar', 'baz'])
+        self.assertListEqual(values.get_values().codes.tolist(), [0, 1, 2, 0])
+        self.assertListEqual(values.get_null_indices().tolist(), [3])
+
+        # the values of a replacement that does not extend it are merged into the earlier ones
+        b = self.pa(create_mixed_dictionary_batches)
+        values = bamboo_cpp.convert_arrow(io.BytesIO(b)).get_list().get_field(FIELD_NAME)
+        self.assertListEqual(list(values.get_values().categories), ['foo', 'bar', 'baz'])
+        self.assertListEqual(values.get_values().codes.tolist(), [0, 1, 2, 0])
+        self.assertListEqual(values.get_null_indices().tolist(), [3])
+
+    def test_buffer(self):
+        import bamboo_cpp_bind as bamboo_cpp
+        from bamboo import from_arrow
+        b = bytearray(self.pa(create_batches))
+        node = bamboo_cpp.convert_arrow(b)
+        # the values read in place keep the buffer alive
+        del b
+        records = node.get_list()
+        self.assertEqual(records.get_size(), 5)
+        self.assertListEqual(records.get_field(FIELD_NAME).get_values().tolist(), [1, 2, 3, 4])
+        self.assertListEqual(records.get_field('str').get_values().tolist(), ['a', 'b', 'c'])
+
+        df = from_arrow(memoryview(self.pa(create_batches)), include=['str']).flatten()
+        self.assertListEqual(list(df.columns), ['str'])
+
+    def test_file(self):
+        import os
+        import bamboo_cpp_bind as bamboo_cpp
+        path = self.pa(create_file)
+        try:
+            for threads in [1, 2]:
+                node = bamboo_cpp.convert_arrow_file(path, threads=threads)
+                ints = node.get_list().get_field(FIELD_NAME)
+                self.assertListEqual(ints.get_values().tolist(), [0, 1, 3, 4, 6, 7])
+                self.assertListEqual(ints.get_null_indices().tolist(), [2, 5, 8])
+
+            node = bamboo_cpp.convert_arrow_file(path, begin_batch=1, end_batch=2)
+            self.assertListEqual(node.get_index().tolist(), [3])
+            ints = node.get_list().get_field(FIELD_NAME)
+            self.assertListEqual(ints.get_values().tolist(), [3, 4])
+        finally:
+            os.remove(path)
+
+    def test_rewritten_file(self):
+        import os
+        import tempfile
+        import bamboo_cpp_bind as bamboo_cpp
+        # the values (used in place where they have no nulls) do not change when the file is
+        # rewritten or truncated after it is read
+        with tempfile.NamedTemporaryFile(suffix='.arrow', delete=False) as f:
+            f.write(self.pa(create_int_batches))
+        paths = [f.name, self.pa(create_nested_file)]
+        try:
+            nodes = [bamboo_cpp.convert_arrow(paths[0]), bamboo_cpp.convert_arrow_file(paths[1])]
+            for path in paths:
+                size = os.path.getsize(path)
+                with open(path, 'r+b') as f:
+                    f.write(b'\x00' * size)
+                    f.truncate(size // 2)
+            self.assertListEqual(nodes[0].get_list().get_field(FIELD_NAME).get_values().tolist(),
+                                 list(range(300)))
+            self.assertListEqual(nodes[1].get_list().get_field(FIELD_NAME).get_values().tolist(),
+                                 list(range(9)))
+        finally:
+            for path in paths:
+                os.remove(path)
+
+    def test_nested_file(self):
+        import os
+        import bamboo_cpp_bind as bamboo_cpp
+        from bamboo import from_arrow_file
+        from bamboo.core import _extension_node
+        path = self.pa(create_nested_file)
+        try:
+            for threads in [1, 2]:
+                records = bamboo_cpp.convert_arrow_file(path, threads=threads).get_list()
+                self.assertEqual(records.get_size(), 9)
+                self.assertListEqual(records.get_field(FIELD_NAME).get_values().tolist(), list(range(9)))
+
+                strings = records.get_field('str')
+                self.assertListEqual(strings.get_values().tolist(), ['a0', '', 'a1', '', 'a2', ''])
+                self.assertListEqual(strings.get_null_indices().tolist(), [1, 4, 7])
+
+                lists = records.get_field('list')
+                self.assertListEqual(lists.get_index().tolist(), [2, 0, 2, 0, 2, 0])
+                self.assertListEqual(lists.get_null_indices().tolist(), [1, 4, 7])
+                self.assertListEqual(lists.get_list().get_values().tolist(), [0, 1, 1, 2, 2, 3])
+
+                record = records.get_field('record')
+                x = record.get_field('x')
+                self.assertListEqual(x.get_values().tolist(), [0, 7, 1, 7, 2, 7])
+                self.assertListEqual(x.get_null_indices().tolist(), [1, 4, 7])
+                y = record.get_field('y')
+                self.assertListEqual(y.get_index().tolist(), [1, 0, 1, 0, 1, 0])
+                self.assertListEqual(y.get_null_indices().tolist(), [2, 5, 8])
+                self.assertListEqual(y.get_list().get_field('a').get_values().tolist(), [0, 1, 2])
+
+            # the values of each batch are used in place in the buffers read for it, and are not made contiguous by
+            # wrapping the node
+            node = from_arrow_file(path)
+            ints = _extension_node(node).get_list().get_field(FIELD_NAME)
+            self.assertListEqual([chunk.tolist() for chunk in ints.get_value_chunks()],
+                                 [[0, 1, 2], [3, 4, 5], [6, 7, 8]])
+            df_equality(self, {FIELD_NAME: list(range(9))}, node.flatten(include=[FIELD_NAME]))
+
+            # (a path-like object is read as its path)
+            import pathlib
+            node = from_arrow_file(pathlib.Path(path), include=[FIELD_NAME], begin_batch=1, end_batch=2)
+            df_equality(self, {FIELD_NAME: [3, 4, 5]}, node.flatten())
+        finally:
+            os.remove(path)
+
     def test_int8(self):
         b, arr = self.pa(create_int8)
         self.assert_array(b, arr)
@@ -180,11 +527,57 @@ class ArrowTests(TestCase):
         self.assertListEqual(node.get_null_indices().tolist(), [1])
 
     def test_time32(self):
-        with self.assertRaises(RuntimeError) as context:
-            b, arr = self.pa(create_time32)
-            self.assert_array(b, arr)
+        b, arr = self.pa(create_time32)
+        node = self.array_convert(b)
+        values = node.get_values()
+        self.assertEqual(values.dtype, np.dtype('timedelta64[s]'))
+        self.assertListEqual(values.astype(np.int64).tolist(), [1, 2])
+
+    def test_date32(self):
+        b, _ = self.pa(create_date32)
+        node = self.array_convert(b)
+        values = node.get_values()
+        self.assertEqual(values.dtype, np.dtype('datetime64[D]'))
+        self.assertListEqual(values.astype(str).tolist(), ['1970-01-01', '1971-01-01'])
+        self.assertListEqual(node.get_null_indices().tolist(), [1])
+
+    def test_timestamp(self):
+        b, _ = self.pa(create_timestamp)
+        node = self.array_convert(b)
+        values = node.get_values()
+        self.assertEqual(values.dtype, np.dtype('datetime64[ms]'))
+        self.assertListEqual(values.astype(np.int64).tolist(), [1, 2])
+        self.assertEqual(node.get_timezone(), 'America/New_York')
 
-        self.assertTrue('not implemented' in str(context.exception))
+    def test_timestamp_flatten(self):
+        import pandas as pd
+        from bamboo import from_arrow
+        b, _ = self.pa(create_timestamp)
+        df = from_arrow(b).flatten()
+        self.assertEqual(str(df[FIELD_NAME].dt.tz), 'America/New_York')
+        expected = pd.to_datetime([1, 2], unit='ms', utc=True).tz_convert('America/New_York')
+        self.assertListEqual(df[FIELD_NAME].tolist(), list(expected))
+
+    def test_decimal(self):
+        from decimal import Decimal
+        b, _ = self.pa(create_decimal)
+        node = self.array_convert(b)
+        values = node.get_values().tolist()
+        self.assertListEqual(values, [Decimal('1.25'), Decimal('-3.50')])
+        self.assertListEqual([str(value) for value in values], ['1.25', '-3.50'])
+        self.assertListEqual(node.get_null_indices().tolist(), [1])
+
+    def test_wide_decimal(self):
+        from decimal import Decimal
+        b, _ = self.pa(create_wide_decimal)
+        values = self.array_convert(b).get_values().tolist()
+        self.assertListEqual([str(value) for value in values], WIDE_DECIMALS)
+
+    def test_fixed_binary(self):
+        b, _ = self.pa(create_fixed_binary)
+        node = self.array_convert(b)
+        self.assertListEqual(node.get_values().tolist(), [b'ab', b'cd'])
+        self.assertListEqual(node.get_null_indices().tolist(), [1])
 
     # arrow does not support null time32
     #def test_null_time32(self):
@@ -212,15 +605,29 @@ class ArrowTests(TestCase):
 
     def test_binary(self):
         b, arr = self.pa(create_binary)
-        with self.assertRaises(RuntimeError) as context:
-            self.assert_array(b, arr)
-
-        self.assertTrue('not implemented' in str(context.exception))
+        node = self.array_convert(b)
+        self.assertListEqual(node.get_values().tolist(), [b't', b'e', b's', b't'])
 
     def test_bool(self):
         b, arr = self.pa(create_bool)
         self.assert_array(b, arr)
 
+    def test_null_bool(self):
+        b, _ = self.pa(create_null_bool)
+        node = self.array_convert(b)
+        self.assertListEqual(node.get_values().tolist(), [False, True])
+        self.assertListEqual(node.get_null_indices().tolist(), [1])
+
+    def test_string(self):
+        b, arr = self.pa(create_string)
+        self.assert_array(b, arr)
+
+    def test_null_string(self):
+        b, _ = self.pa(create_null_string)
+        node = self.array_convert(b)
+        self.assertListEqual(node.get_values().tolist(), ['a', 'bcd'])
+        self.assertListEqual(node.get_null_indices().tolist(), [1])
+
     def test_dictionary(self):
         b, arr = self.pa(create_dictionary)
         node = self.array_convert(b)
@@ -244,6 +651,17 @@ class ArrowTests(TestCase):
         self.assertListEqual(node.get_list().get_values().tolist(), [1, 2, 3])
         self.assertListEqual(node.get_list().get_null_indices().tolist(), [2])
 
+    def test_column_filter(self):
+        from bamboo import from_arrow
+        b = self.pa(create_batches)
+        df = from_arrow(io.BytesIO(b), include=['str']).flatten()
+        self.assertListEqual(list(df.columns), ['str'])
+        self.assertEqual(len(df), 5)
+
+        b, _ = self.pa(create_flatten)
+        node = from_arrow(io.BytesIO(b), exclude=['arr.y'])
+        df_equality(self, {'x': [1, 2]}, node.flatten())
+
     def test_flatten(self):
         from bamboo import from_arrow
         b, arr = self.pa(create_flatten)
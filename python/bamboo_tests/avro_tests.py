@@ -53,8 +53,8 @@ if sys.version_info > (3, 0):
     def make_field(field_name, field_schema, names=None):
         return schema.Field(field_schema, field_name, 0, False, names=names, default=None)
 
-    def make_file_writer(out, datum_writer, datum_schema):
-        return datafile.DataFileWriter(out, datum_writer, writer_schema=datum_schema)
+    def make_file_writer(out, datum_writer, datum_schema, codec='null'):
+        return datafile.DataFileWriter(out, datum_writer, writer_schema=datum_schema, codec=codec)
 
     def make_array_schema(element_schema):
         return schema.ArraySchema(element_schema)
@@ -78,8 +78,8 @@ else:
             field_schema = field_schema.fullname
         return schema.Field(field_schema, field_name, False, names=names, default=None).to_json()
 
-    def make_file_writer(out, datum_writer, datum_schema):
-        return datafile.DataFileWriter(out, datum_writer, writers_schema=datum_schema)
+    def make_file_writer(out, datum_writer, datum_schema, codec='null'):
+        return datafile.DataFileWriter(out, datum_writer, writers_schema=datum_schema, codec=codec)
 
     def make_array_schema(element_schema):
         names = schema.Names()
@@ -133,6 +133,18 @@ def object(datum_schema, value, iterate_over_values=False):
     return BytesIO(out.getvalue())
 
 
+# writes each group of values as a separate block
+def blocked_object(datum_schema, value_blocks, codec):
+    out = BytesIO()
+    datum_writer = io.DatumWriter(datum_schema)
+    file_writer = make_file_writer(out, datum_writer, datum_schema, codec)
+    for values in value_blocks:
+        for v in values:
+            file_writer.append(v)
+        file_writer.flush()
+    return out.getvalue()
+
+
 class AvroTests(TestCase):
     def assert_primitive(self, primitive_schema, primitive_value):
         field_name = 'a'
@@ -171,6 +183,39 @@ class AvroTests(TestCase):
         node = bamboo_cpp.convert_avro(b)
         self.assertListEqual(node.get_list().get_values().tolist(), [value])
 
+    def test_fixed_values(self):
+        names = schema.Names()
+        fixed_schema = schema.FixedSchema("test", "test", 3, names=names)
+        list_schema = make_array_schema(fixed_schema)
+        # (trailing zero bytes are part of the values)
+        value = [b'abc', b'a\x00\x00', b'\x00\x00\x00']
+        b = object(list_schema, value)
+        node = bamboo_cpp.convert_avro(b)
+        values = node.get_list().get_list().get_values()
+        self.assertListEqual(values.tolist(), value)
+
+    def test_fixed_buffer(self):
+        names = schema.Names()
+        fixed_schema = schema.FixedSchema("test", "test", 3, names=names)
+        list_schema = make_array_schema(fixed_schema)
+        value = [b'abc', b'a\x00\x00', b'\x00\x00\x00']
+        b = object(list_schema, value)
+        node = bamboo_cpp.convert_avro(b)
+        data, width = node.get_list().get_list().get_fixed_buffer()
+        self.assertEqual(width, 3)
+        self.assertEqual(data.shape, (3, 3))
+        self.assertEqual(data.dtype, np.uint8)
+        self.assertListEqual([row.tobytes() for row in data], value)
+
+    def test_binary_buffers(self):
+        list_schema = make_array_schema(primitive_schemas.BYTES)
+        value = [b'ab', b'', b'cde']
+        b = object(list_schema, value)
+        node = bamboo_cpp.convert_avro(b)
+        offsets, data = node.get_list().get_list().get_binary_buffers()
+        self.assertListEqual(offsets.tolist(), [0, 2, 2, 5])
+        self.assertEqual(data.tobytes(), b'abcde')
+
     def test_enum(self):
         names = schema.Names()
         enum_schema = schema.EnumSchema("test", "test", ['a', 'b'], names=names)
@@ -220,6 +265,62 @@ class AvroTests(TestCase):
         df = node.flatten()
         df_equality(self, {}, df)
 
+    def test_parallel(self):
+        names = schema.Names()
+        a_field = make_field('a', primitive_schemas.INT)
+        b_schema = make_union_schema([primitive_schemas.STRING, primitive_schemas.NULL])
+        b_field = make_field('b', b_schema)
+        datum_schema = schema.RecordSchema('test', 'test', [a_field, b_field], names=names)
+        value_blocks = [[{'a': i * 10 + j, 'b': None if j % 3 == 0 else str(j)} for j in range(i)]
+                        for i in range(7)]
+        for codec in ['null', 'deflate']:
+            b = blocked_object(datum_schema, value_blocks, codec)
+            for include in [None, ['b']]:
+                serial = from_avro(BytesIO(b), include=include).flatten()
+                parallel = from_avro(BytesIO(b), include=include, threads=4).flatten()
+                self.assertTrue(serial.equals(parallel))
+                for threads in [1, 4]:
+                    in_place = from_avro(memoryview(b), include=include, threads=threads).flatten()
+                    self.assertTrue(serial.equals(in_place))
+                self.assertEqual(len(parallel), sum(len(values) for values in value_blocks))
+
+    def test_concurrent_streams(self):
+        import os
+        import tempfile
+        import threading
+        field_name = 'a'
+        n = 100000
+        b = write_n_simple_objects(field_name, primitive_schemas.INT, n, 2).getvalue()
+
+        # the conversions release the GIL, so they can run at the same time
+        results = [None] * 4
+
+        def run(i):
+            results[i] = bamboo_cpp.convert_avro(BytesIO(b)).get_list().get_field(field_name)
+
+        threads = [threading.Thread(target=run, args=(i,)) for i in range(len(results))]
+        for thread in threads:
+            thread.start()
+        for thread in threads:
+            thread.join()
+        for result in results:
+            self.assertListEqual(result.get_values().tolist(), [2] * n)
+
+        # a file is read directly from its descriptor, from its current position
+        with tempfile.NamedTemporaryFile(delete=False) as f:
+            f.write(b'xyz')
+            f.write(b)
+            path = f.name
+        try:
+            with open(path, 'rb') as f:
+                f.read(3)
+                node = bamboo_cpp.convert_avro(f)
+                self.assertEqual(f.tell(), len(b) + 3)
+            self.assertListEqual(node.get_list().get_field(field_name).get_values().tolist(),
+                                 [2] * n)
+        finally:
+            os.remove(path)
+
     def test_deep_column_filter(self):
         names = schema.Names()
         ia = 'ia'
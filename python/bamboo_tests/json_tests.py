@@ -19,12 +19,14 @@ import six
 
 from unittest import TestCase
 
+import gc
 import json
 import io
 import numpy as np
 
 import bamboo_cpp_bind as bamboo_cpp
 from bamboo import from_json
+from bamboo.core import concat
 
 from bamboo_tests.test_utils import df_equality
 
@@ -41,6 +43,99 @@ class JsonTests(TestCase):
         node = self.convert_obj(obj)
         self.assertListEqual(node.get_values().tolist(), [3])
 
+    def test_float_in_comma_locale(self):
+        import locale
+        saved = locale.setlocale(locale.LC_NUMERIC)
+        for name in ['de_DE.UTF-8', 'de_DE.utf8', 'fr_FR.UTF-8', 'fr_FR.utf8']:
+            try:
+                locale.setlocale(locale.LC_NUMERIC, name)
+                break
+            except locale.Error:
+                pass
+        else:
+            self.skipTest('no locale with a comma decimal point is available')
+        try:
+            # (too many digits for the fast path, so the number is parsed by strtod)
+            node = bamboo_cpp.convert_json(b'[1.2345678901234567890, 2.5]')
+            self.assertListEqual(node.get_list().get_values().tolist(), [1.2345678901234567, 2.5])
+        finally:
+            locale.setlocale(locale.LC_NUMERIC, saved)
+
+    def test_repeated_member(self):
+        # the last value of a repeated member wins (including over nested values and nulls)
+        b = b'[{"a": 1, "b": [1, 2], "a": 2}, {"b": [5, 6], "a": null, "b": [3], "a": 3}, ' \
+            b'{"a": 4, "a": null, "b": null}]'
+        node = bamboo_cpp.convert_json(b)
+        a = node.get_list().get_field('a')
+        self.assertListEqual(a.get_values().tolist(), [2, 3])
+        self.assertListEqual(a.get_null_indices().tolist(), [2])
+        lists = node.get_list().get_field('b')
+        self.assertListEqual(lists.get_index().tolist(), [2, 1])
+        self.assertListEqual(lists.get_null_indices().tolist(), [2])
+        self.assertListEqual(lists.get_list().get_values().tolist(), [1, 2, 3])
+
+    def test_buffer(self):
+        b = six.ensure_binary(json.dumps([{'a': 1}, {'a': 2}]), 'utf8')
+        for buffer in [b, bytearray(b), memoryview(b), np.frombuffer(b, dtype=np.uint8)]:
+            node = bamboo_cpp.convert_json(buffer)
+            self.assertListEqual(node.get_list().get_field('a').get_values().tolist(), [1, 2])
+
+    def test_files(self):
+        import os
+        import pathlib
+        import tempfile
+        import threading
+        b = six.ensure_binary(json.dumps([{'a': 1}, {'a': 2}]), 'utf8')
+
+        def assert_values(node):
+            self.assertListEqual(node.get_list().get_field('a').get_values().tolist(), [1, 2])
+
+        with tempfile.NamedTemporaryFile(suffix='.json', delete=False) as f:
+            f.write(b)
+            path = f.name
+        try:
+            assert_values(bamboo_cpp.convert_json(path))
+            df_equality(self, {'a': [1, 2]}, from_json(pathlib.Path(path)).flatten())
+            with open(path, 'rb') as f:
+                assert_values(bamboo_cpp.convert_json(f))
+                self.assertEqual(f.tell(), len(b))
+        finally:
+            os.remove(path)
+
+        # a pipe is read directly from its descriptor
+        read_fd, write_fd = os.pipe()
+
+        def write():
+            with os.fdopen(write_fd, 'wb') as w:
+                w.write(b)
+
+        writer = threading.Thread(target=write)
+        writer.start()
+        with os.fdopen(read_fd, 'rb', buffering=0) as r:
+            assert_values(bamboo_cpp.convert_json(r))
+        writer.join()
+
+    def test_compressed_file(self):
+        import gzip
+        import os
+        import tempfile
+        b = six.ensure_binary(json.dumps([{'a': i} for i in range(1000)]), 'utf8')
+
+        # the file object has a descriptor, but it must be read through (as the file is compressed)
+        with tempfile.NamedTemporaryFile(suffix='.json.gz', delete=False) as f:
+            path = f.name
+        try:
+            with gzip.open(path, 'wb') as g:
+                g.write(b)
+            with gzip.open(path, 'rb') as g:
+                node = bamboo_cpp.convert_json(g)
+                self.assertListEqual(node.get_list().get_field('a').get_values().tolist(),
+                                     list(range(1000)))
+            with gzip.open(path, 'rb') as g:
+                df_equality(self, {'a': list(range(1000))}, from_json(g).flatten())
+        finally:
+            os.remove(path)
+
     def test_struct_with_list(self):
         obj = [{'a': None, 'b': [2, 3]}, {'a': 1, 'b': [2, 4]}]
         node = self.convert_obj(obj)
@@ -48,6 +143,169 @@ class JsonTests(TestCase):
         self.assertListEqual(node.get_list().get_field('a').get_values().tolist(), [1])
         self.assertListEqual(node.get_list().get_field('a').get_null_indices().tolist(), [0])
 
+    def test_missing_fields(self):
+        obj = [{'a': 1}, {'b': 'x'}, None, {'a': 2, 'b': 'y'}]
+        records = self.convert_obj(obj).get_list()
+        self.assertListEqual(records.get_null_indices().tolist(), [2])
+        self.assertListEqual(records.get_field('a').get_values().tolist(), [1, 2])
+        self.assertListEqual(records.get_field('a').get_null_indices().tolist(), [1])
+        self.assertListEqual(records.get_field('b').get_values().tolist(), ['x', 'y'])
+        self.assertListEqual(records.get_field('b').get_null_indices().tolist(), [0])
+
+    def test_lines(self):
+        objs = [{'a': i} for i in range(100)] + [{'a': 100, 'b': 'x'}]
+        text = '\n'.join(json.dumps(obj) for obj in objs) + '\n\n'
+        for threads in [1, 4]:
+            node = bamboo_cpp.convert_json_lines(six.ensure_binary(text, 'utf8'), threads=threads)
+            self.assertListEqual(node.get_index().tolist(), [101])
+            records = node.get_list()
+            self.assertListEqual(records.get_field('a').get_values().tolist(), list(range(101)))
+            # a field first seen at the end is null for the earlier lines
+            self.assertListEqual(records.get_field('b').get_values().tolist(), ['x'])
+            self.assertListEqual(records.get_field('b').get_null_indices().tolist(),
+                                 list(range(100)))
+
+            df = from_json(text, lines=True, threads=threads).flatten()
+            self.assertEqual(len(df), 101)
+            # (the expected rows are only a hint)
+            for expected_rows in [10, 1000]:
+                df = from_json(text, lines=True, threads=threads,
+                               expected_rows=expected_rows).flatten()
+                self.assertEqual(len(df), 101)
+                df = from_json(json.dumps(objs), expected_rows=expected_rows).flatten()
+                self.assertEqual(len(df), 101)
+
+        # the options can only be given by keyword
+        with self.assertRaises(TypeError):
+            from_json(text, None, None, None, True)
+
+    def test_strings(self):
+        # long enough to be indexed in several windows, with escapes and structural characters
+        # within the strings (and across the blocks they are classified in)
+        values = [u'{}[]:,' * (i % 7) + u'\\' * (i % 3) + u'"\u00e9\n' + u'x' * (i % 70)
+                  for i in range(2000)]
+        obj = [{'s': value, 'f': i / 8.0} for i, value in enumerate(values)]
+        records = bamboo_cpp.convert_json(six.ensure_binary(json.dumps(obj), 'utf8')).get_list()
+        self.assertListEqual(records.get_field('s').get_values().tolist(), values)
+        self.assertListEqual(records.get_field('f').get_values().tolist(),
+                             [i / 8.0 for i in range(2000)])
+
+        with self.assertRaises(ValueError):
+            bamboo_cpp.convert_json(b'["\xff"]')
+
+    def test_classifiers(self):
+        import random
+        # each classifier the processor supports must index the same documents (the others are
+        # tested on the processors that support them)
+        classifiers = bamboo_cpp.json_classifiers()
+        self.assertEqual(classifiers[-1], 'scalar')
+        rng = random.Random(1)
+        alphabet = u'{}[]:,"\\ \t\n\x01a1\u00e9\U0001f600'
+        values = [u''.join(rng.choice(alphabet) for _ in range(rng.randrange(200)))
+                  for _ in range(500)]
+        obj = [{'s': value, 'l': [i, None], 'r': {'n': -i}} for i, value in enumerate(values)]
+        # (the non-ASCII characters are left unescaped)
+        text = six.ensure_binary(json.dumps(obj, ensure_ascii=False), 'utf8')
+        lines = six.ensure_binary('\n'.join(json.dumps(o, ensure_ascii=False) for o in obj),
+                                  'utf8')
+        original = bamboo_cpp.get_json_classifier()
+        try:
+            for classifier in classifiers:
+                bamboo_cpp.set_json_classifier(classifier)
+                self.assertEqual(bamboo_cpp.get_json_classifier(), classifier)
+                for node in [bamboo_cpp.convert_json(text).get_list(),
+                             bamboo_cpp.convert_json_lines(lines, threads=2).get_list()]:
+                    self.assertListEqual(node.get_field('s').get_values().tolist(), values)
+                    entries = node.get_field('l').get_list()
+                    self.assertListEqual(entries.get_values().tolist(), list(range(500)))
+                    self.assertListEqual(entries.get_null_indices().tolist(),
+                                         list(range(1, 1000, 2)))
+                    self.assertListEqual(node.get_field('r').get_field('n').get_values().tolist(),
+                                         [-i for i in range(500)])
+                self.test_strings()
+                self.test_column_filter()
+                self.test_missing_fields()
+        finally:
+            bamboo_cpp.set_json_classifier(original)
+
+        with self.assertRaises(ValueError):
+            bamboo_cpp.set_json_classifier('none')
+
+    def test_column_filter(self):
+        # the excluded member would otherwise fail to convert (it mixes types)
+        obj = [{'a': {'b': 1, 'c': 'x'}, 'd': [1, 'y', {'e': [2]}]},
+               {'a': {'b': 2, 'c': 'z'}, 'd': None}]
+        text = json.dumps(obj)
+        df = from_json(text, exclude=['d']).flatten()
+        df_equality(self, {'b': [1, 2], 'c': ['x', 'z']}, df)
+
+        df = from_json(text, include=['a.b']).flatten()
+        df_equality(self, {'b': [1, 2]}, df)
+
+        lines = '\n'.join(json.dumps(o) for o in obj)
+        for threads in [1, 2]:
+            df = from_json(lines, include=['a.c'], lines=True, threads=threads).flatten()
+            df_equality(self, {'c': ['x', 'z']}, df)
+
+        # excluded nulls are skipped like any other value
+        records = from_json('[{"a": null, "b": 1}, {"a": [null], "b": null}]', exclude=['a'])
+        df_equality(self, {'b': [1, np.nan]}, records.flatten())
+
+        # an excluded string that is cut off after a backslash
+        with self.assertRaises(ValueError):
+            from_json('[{"a":"abc\\', exclude=['a'])
+
+    def test_schema(self):
+        schema = {'type': 'record', 'name': 'r', 'fields': [
+            {'name': 'a', 'type': 'double'},
+            {'name': 'b', 'type': ['null', 'int']},
+            {'name': 'c', 'type': {'type': 'array', 'items': 'string'}},
+            {'name': 'd', 'type': 'long'}]}
+        text = '\n'.join(json.dumps(obj) for obj in [{'a': 1, 'b': 2}, {'a': 2.5, 'b': None}])
+        for threads in [1, 2]:
+            node = bamboo_cpp.convert_json_lines(six.ensure_binary(text, 'utf8'),
+                                                 schema=bamboo_cpp.json_schema(json.dumps(schema)),
+                                                 threads=threads)
+            records = node.get_list()
+            # the integer is converted to the declared type
+            a = records.get_field('a')
+            self.assertEqual(a.get_type(), bamboo_cpp.PrimitiveType.FLOAT64)
+            self.assertListEqual(a.get_values().tolist(), [1.0, 2.5])
+            b = records.get_field('b')
+            self.assertEqual(b.get_type(), bamboo_cpp.PrimitiveType.INT32)
+            self.assertListEqual(b.get_values().tolist(), [2])
+            self.assertListEqual(b.get_null_indices().tolist(), [1])
+            # declared fields that never appear are null
+            self.assertListEqual(records.get_field('c').get_null_indices().tolist(), [0, 1])
+            d = records.get_field('d')
+            self.assertEqual(d.get_type(), bamboo_cpp.PrimitiveType.INT64)
+            self.assertListEqual(d.get_null_indices().tolist(), [0, 1])
+
+        df = from_json(text, schema=schema, lines=True).flatten()
+        self.assertListEqual(df['a'].tolist(), [1.0, 2.5])
+
+        # a node from an earlier conversion may be used as the schema
+        first = self.convert_obj([{'x': 1.5}])
+        node = bamboo_cpp.convert_json(b'[{"x": 2}]', schema=first)
+        self.assertListEqual(node.get_list().get_field('x').get_values().tolist(), [2.0])
+        # (including the result of from_json)
+        df = from_json('[{"x": 2}]', schema=from_json('[{"x": 1.5}]')).flatten()
+        self.assertListEqual(df['x'].tolist(), [2.0])
+        self.assertEqual(df['x'].dtype, np.float64)
+
+        # (as are the entries of an array)
+        schema = {'type': 'array', 'items': {'type': 'array', 'items': 'float'}}
+        node = bamboo_cpp.convert_json(b'[[1, 2.5], [], [null, 3]]',
+                                       schema=bamboo_cpp.json_schema(json.dumps(schema)))
+        entries = node.get_list().get_list()
+        self.assertEqual(entries.get_type(), bamboo_cpp.PrimitiveType.FLOAT32)
+        self.assertListEqual(entries.get_values().tolist(), [1.0, 2.5, 3.0])
+        self.assertListEqual(entries.get_null_indices().tolist(), [2])
+
+        with self.assertRaises(ValueError) as context:
+            from_json('[1, 4294967296]', schema={'type': 'array', 'items': 'int'})
+        self.assertTrue('out of range' in str(context.exception))
+
     def test_flatten(self):
         obj = [{'a': None, 'b': [1, 2], 'c': [5, 6]}, {'a': -1.0, 'b': [3, 4], 'c': [7, 8]}]
         node = from_json(json.dumps(obj))
@@ -56,6 +314,32 @@ class JsonTests(TestCase):
         df_equality(self, {'a': [np.nan, -1.0]}, df_a)
         df_equality(self, {'a': [np.nan, np.nan, -1.0, -1.0], 'b': [1, 2, 3, 4]}, df_b)
 
+    def test_concat(self):
+        first = self.convert_obj([{'a': 1}, None])
+        second = self.convert_obj([{'a': 2, 'b': 'x'}, {'a': None, 'b': 'y'}])
+        node = bamboo_cpp.concat([first, second])
+        self.assertListEqual(node.get_index().tolist(), [2, 2])
+        records = node.get_list()
+        self.assertListEqual(records.get_null_indices().tolist(), [1])
+        self.assertListEqual(records.get_field('a').get_values().tolist(), [1, 2])
+        self.assertListEqual(records.get_field('a').get_null_indices().tolist(), [2])
+        self.assertListEqual(records.get_field('b').get_values().tolist(), ['x', 'y'])
+        self.assertListEqual(records.get_field('b').get_null_indices().tolist(), [0])
+        self.assertEqual(first.get_size(), 2)
+
+    def test_concat_wrapped(self):
+        first = from_json(json.dumps([{'a': i} for i in range(1000)]))
+        second = from_json(json.dumps([{'a': i, 'b': 'x'} for i in range(1000, 2000)]))
+        # the values of the given nodes are already viewed by their wrappers (and by this array)
+        values = first.flatten()['a'].values
+        node = concat([first, second])
+        del node
+        gc.collect()
+        self.assertListEqual(values.tolist(), list(range(1000)))
+        df_equality(self, {'a': list(range(1000))}, first.flatten())
+        df = concat([first, second]).flatten(include=['a'])
+        df_equality(self, {'a': list(range(2000))}, df)
+
     def test_mixed_schema(self):
         with self.assertRaises(ValueError) as context:
             obj = [{'a': None, 'b': [2, False]}, {'a': 1, 'b': [2, 4]}]
@@ -63,3 +347,22 @@ class JsonTests(TestCase):
 
         self.assertTrue('Mismatched primitive types' in str(context.exception))
 
+    def test_dense_nulls(self):
+        obj = [{'a': None} if i % 2 else {'a': i} for i in range(1000)]
+        node = self.convert_obj(obj)
+        a = node.get_list().get_field('a')
+        self.assertTrue(a.is_null_bitmap())
+        self.assertEqual(a.get_null_count(), 500)
+        self.assertListEqual(a.get_null_indices().tolist(), list(range(1, 1000, 2)))
+        self.assertListEqual(a.get_not_null_mask().tolist(), [i % 2 == 0 for i in range(1000)])
+
+        df = from_json(json.dumps(obj)).flatten()
+        df_equality(self, {'a': [np.nan if i % 2 else i for i in range(1000)]}, df)
+
+    def test_string_buffers(self):
+        node = self.convert_obj(['a', 'bc', None, ''])
+        strings = node.get_list()
+        offsets, data = strings.get_string_buffers()
+        self.assertListEqual(offsets.tolist(), [0, 1, 3, 3])
+        self.assertEqual(data.tobytes(), b'abc')
+        self.assertListEqual(strings.get_values().tolist(), ['a', 'bc', ''])
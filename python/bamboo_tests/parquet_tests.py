@@ -0,0 +1,137 @@
+# Copyright (c) 2019 Michael Vilim
+#
+# This file is part of the bamboo library. It is currently hosted at
+# https://github.com/mvilim/bamboo
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#    http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+from unittest import TestCase
+
+import os
+
+# as with the arrow tests, the parquet files are written with pyarrow in another process
+import multiprocessing as mp
+
+from bamboo_tests.arrow_tests import pyarrow_runner
+
+
+def create_file():
+    import pyarrow as pa
+    import pyarrow.parquet as pq
+    import tempfile
+    with tempfile.NamedTemporaryFile(suffix='.parquet', delete=False) as f:
+        path = f.name
+    table = pa.Table.from_pydict({
+        'x': pa.array([1, None, 3, 4], type=pa.int64()),
+        's': pa.array([u'a', u'b', None, u'd']),
+        'l': pa.array([[1, None], None, [], [2]], type=pa.list_(pa.int32())),
+        'r': pa.array([{'a': 1, 'b': 2.5}, None, {'a': None, 'b': 1.0}, {'a': 4, 'b': 0.5}])
+    })
+    # two rows per row group
+    pq.write_table(table, path, row_group_size=2)
+    return path
+
+
+def create_decimal_file():
+    import pyarrow as pa
+    import pyarrow.parquet as pq
+    import tempfile
+    from decimal import Decimal
+    with tempfile.NamedTemporaryFile(suffix='.parquet', delete=False) as f:
+        path = f.name
+    # (written as big endian fixed length byte arrays)
+    table = pa.Table.from_pydict({
+        'd': pa.array([Decimal('1.25'), None, Decimal('-3.50'),
+                       Decimal('-12345678901234567890.12')], type=pa.decimal128(22, 2))
+    })
+    pq.write_table(table, path)
+    return path
+
+
+class ParquetTests(TestCase):
+    def pa(self, f):
+        type(self)._parent_pipe.send(f)
+        return type(self)._parent_pipe.recv()
+
+    @classmethod
+    def setUpClass(cls):
+        context = mp.get_context('spawn')
+        cls._parent_pipe, child_pipe = context.Pipe()
+        cls._runner = context.Process(target=pyarrow_runner, args=(child_pipe,))
+        cls._runner.start()
+
+    @classmethod
+    def tearDownClass(cls):
+        cls._parent_pipe.send(None)
+        cls._runner.join()
+
+    def test_file(self):
+        import bamboo_cpp_bind as bamboo_cpp
+        path = self.pa(create_file)
+        try:
+            for threads in [1, 2]:
+                node = bamboo_cpp.convert_parquet(path, expected_rows=10, threads=threads)
+                self.assertListEqual(node.get_index().tolist(), [4])
+                rows = node.get_list()
+
+                x = rows.get_field('x')
+                self.assertListEqual(x.get_values().tolist(), [1, 3, 4])
+                self.assertListEqual(x.get_null_indices().tolist(), [1])
+
+                s = rows.get_field('s')
+                self.assertListEqual(s.get_values().tolist(), ['a', 'b', 'd'])
+                self.assertListEqual(s.get_null_indices().tolist(), [2])
+
+                l = rows.get_field('l')
+                self.assertListEqual(l.get_index().tolist(), [2, 0, 1])
+                self.assertListEqual(l.get_null_indices().tolist(), [1])
+                self.assertListEqual(l.get_list().get_values().tolist(), [1, 2])
+                self.assertListEqual(l.get_list().get_null_indices().tolist(), [1])
+
+                r = rows.get_field('r')
+                self.assertListEqual(r.get_null_indices().tolist(), [1])
+                self.assertListEqual(r.get_field('a').get_values().tolist(), [1, 4])
+                self.assertListEqual(r.get_field('a').get_null_indices().tolist(), [1])
+                self.assertListEqual(r.get_field('b').get_values().tolist(), [2.5, 1.0, 0.5])
+        finally:
+            os.remove(path)
+
+    def test_decimal(self):
+        import bamboo_cpp_bind as bamboo_cpp
+        path = self.pa(create_decimal_file)
+        try:
+            d = bamboo_cpp.convert_parquet(path).get_list().get_field('d')
+            self.assertListEqual([str(value) for value in d.get_values().tolist()],
+                                 ['1.25', '-3.50', '-12345678901234567890.12'])
+            self.assertListEqual(d.get_null_indices().tolist(), [1])
+        finally:
+            os.remove(path)
+
+    def test_column_filter(self):
+        from bamboo import from_parquet
+        path = self.pa(create_file)
+        try:
+            df = from_parquet(path, include=['r.b']).flatten()
+            self.assertListEqual(list(df.columns), ['b'])
+
+            df = from_parquet(path, exclude=['l', 'r', 's']).flatten()
+            self.assertListEqual(list(df.columns), ['x'])
+            self.assertEqual(len(df), 4)
+
+            # (a path-like object is read as its path)
+            import pathlib
+            df = from_parquet(pathlib.Path(path), include=['x'], threads=2).flatten()
+            self.assertListEqual(list(df.columns), ['x'])
+            self.assertEqual(len(df), 4)
+        finally:
+            os.remove(path)
@@ -66,6 +66,15 @@ class PBDTests(TestCase):
                            'd': [-1.3, -1.3], 'e': ['B', 'B'], 'f': [2.3, 3.3], 's': ['test', 'test'],
                            'sd': ['', ''], 'de': ['DE1', 'DE1']}, df)
 
+    def test_expected_rows(self):
+        file = open(os.path.join(os.path.dirname(__file__), 'data', 'example.pbd'), 'rb')
+        example = file.read()
+        file.close()
+
+        expected = self.read_example().flatten(exclude=['rm'])
+        df = from_pbd(io.BytesIO(example), expected_rows=1000).flatten(exclude=['rm'])
+        df_equality(self, expected, df)
+
     def test_repeated_message(self):
         node = self.read_example()
         df = node.flatten(include=['rm'])
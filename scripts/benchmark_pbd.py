@@ -0,0 +1,64 @@
+# Copyright (c) 2019 Michael Vilim
+#
+# This file is part of the bamboo library. It is currently hosted at
+# https://github.com/mvilim/bamboo
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#    http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+# Measures the per record (C++) conversion cost of the perf_example.pbd workload (the same input as
+# PBDTests.test_perf). Run against two builds to compare them, e.g.:
+#
+#   python scripts/benchmark_pbd.py --records 1000000 --repeat 5
+
+import argparse
+import io
+import os
+
+from time import perf_counter as clock
+
+import bamboo_cpp_bind as bamboo_cpp
+
+N_RECORD_BYTES = 82
+
+
+def load_example():
+    path = os.path.join(os.path.dirname(__file__), '..', 'python', 'bamboo_tests', 'data',
+                        'perf_example.pbd')
+    with open(path, 'rb') as f:
+        return f.read()
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Benchmark protobuf conversion')
+    parser.add_argument('--records', type=int, default=1000000)
+    parser.add_argument('--repeat', type=int, default=5)
+    args = parser.parse_args()
+
+    example = load_example()
+    header_bytes = example[:-N_RECORD_BYTES]
+    record_bytes = example[-N_RECORD_BYTES:]
+    data = header_bytes + record_bytes * args.records
+
+    timings = []
+    for _ in range(args.repeat):
+        t0 = clock()
+        bamboo_cpp.convert_pbd(io.BytesIO(data))
+        timings.append(clock() - t0)
+
+    best = min(timings)
+    print('bamboo {}: {} records, best of {}: {:.3f} s ({:.1f} ns/record)'.format(
+        bamboo_cpp.__version__, args.records, args.repeat, best, best / args.records * 1e9))
+
+
+if __name__ == '__main__':
+    main()